@@ -0,0 +1,227 @@
+// Load-test harness for the embedded DNS responder. Runs the responder pinned to one core against a synthetic
+// blocklist, drives it from loopback clients with a fixed in-flight window and reports sustained QPS.
+//
+//   dns-bench [--domains N] [--seconds S] [--clients C] [--window W] [--blocked-ratio R] [--core K]
+//
+
+#include "include/DNSResponder.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace {
+
+struct Options {
+    size_t domains = 1'000'000, clients = 2, window = 256;
+    unsigned int seconds = 5, core = 0;
+    double blocked_ratio = 0.9;
+};
+
+constexpr size_t BATCH = 64;
+
+std::vector<uint8_t> make_query(uint16_t id, const std::string& name) {
+    std::vector<uint8_t> query{static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id), 0x01, 0x00,
+                               0, 1, 0, 0, 0, 0, 0, 0};
+    size_t start = 0;
+    while (start <= name.size()) {
+        auto dot = std::min(name.find('.', start), name.size());
+        query.push_back(static_cast<uint8_t>(dot - start));
+        query.insert(query.end(), name.begin() + static_cast<long>(start), name.begin() + static_cast<long>(dot));
+        start = dot + 1;
+    }
+    query.insert(query.end(), {0, 0, 1, 0, 1});
+    return query;
+}
+
+sockaddr_in loopback(uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+void pin_to_core(unsigned int core) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// echoes every relayed query back as an answer, batched so it never becomes the bottleneck
+void run_upstream(int fd, const std::atomic<bool>& running) {
+    std::vector<std::array<uint8_t, 512>> buffers(BATCH);
+    std::vector<sockaddr_in> addresses(BATCH);
+    std::vector<iovec> iovecs(BATCH);
+    std::vector<mmsghdr> headers(BATCH);
+
+    while (running) {
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, 50) <= 0) continue;
+
+        for (size_t i = 0; i < BATCH; ++i) {
+            iovecs[i] = {buffers[i].data(), buffers[i].size()};
+            headers[i].msg_hdr = {};
+            headers[i].msg_hdr.msg_name = &addresses[i];
+            headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(fd, headers.data(), BATCH, MSG_DONTWAIT, nullptr);
+        for (int i = 0; i < n; ++i) {
+            buffers[i][2] |= 0x80;
+            iovecs[i].iov_len = headers[i].msg_len;
+        }
+        if (n > 0) sendmmsg(fd, headers.data(), static_cast<unsigned int>(n), 0);
+    }
+}
+
+uint64_t run_client(uint16_t port, const std::vector<std::vector<uint8_t>>& queries, size_t window,
+                    const std::atomic<bool>& running) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    auto address = loopback(port);
+    connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    int buffer_size = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+    std::vector<std::array<uint8_t, 512>> buffers(BATCH);
+    std::vector<iovec> iovecs(BATCH);
+    std::vector<mmsghdr> headers(BATCH);
+    uint64_t answered = 0;
+    size_t in_flight = 0, next = 0;
+
+    while (running) {
+        while (in_flight < window) {
+            auto count = std::min(BATCH, window - in_flight);
+            for (size_t i = 0; i < count; ++i, ++next) {
+                const auto& query = queries[next % queries.size()];
+                iovecs[i] = {const_cast<uint8_t*>(query.data()), query.size()};
+                headers[i].msg_hdr = {};
+                headers[i].msg_hdr.msg_iov = &iovecs[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+            }
+            int sent = sendmmsg(fd, headers.data(), static_cast<unsigned int>(count), 0);
+            if (sent <= 0) break;
+            in_flight += static_cast<size_t>(sent);
+        }
+
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            in_flight = 0;  // assume losses and refill the window
+            continue;
+        }
+
+        for (size_t i = 0; i < BATCH; ++i) {
+            iovecs[i] = {buffers[i].data(), buffers[i].size()};
+            headers[i].msg_hdr = {};
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+        int received = recvmmsg(fd, headers.data(), BATCH, MSG_DONTWAIT, nullptr);
+        if (received > 0) {
+            answered += static_cast<uint64_t>(received);
+            in_flight -= std::min(in_flight, static_cast<size_t>(received));
+        }
+    }
+
+    close(fd);
+    return answered;
+}
+
+Options parse(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--domains") options.domains = std::stoul(value);
+        else if (flag == "--seconds") options.seconds = std::stoul(value);
+        else if (flag == "--clients") options.clients = std::stoul(value);
+        else if (flag == "--window") options.window = std::stoul(value);
+        else if (flag == "--blocked-ratio") options.blocked_ratio = std::stod(value);
+        else if (flag == "--core") options.core = std::stoul(value);
+        else throw std::invalid_argument("Unknown option: " + flag);
+    }
+    return options;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    auto options = parse(argc, argv);
+
+    std::cout << "Building index with " << options.domains << " domains..." << std::endl;
+    std::vector<std::unordered_set<std::string>> lists(2);
+    for (size_t i = 0; i < options.domains; ++i)
+        lists[i % 2].insert("host" + std::to_string(i) + ".blocked-" + std::to_string(i % 997) + ".example");
+    auto index = std::make_shared<DomainIndex>(lists);
+    lists.clear();
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::uniform_int_distribution<size_t> pick(0, options.domains - 1);
+    std::vector<std::vector<uint8_t>> queries;
+    for (uint16_t id = 0; id < 8192; ++id) {
+        bool block = coin(rng) < options.blocked_ratio;
+        auto i = pick(rng);
+        auto name = block ? "cdn.host" + std::to_string(i) + ".blocked-" + std::to_string(i % 997) + ".example"
+                          : "www.allowed-" + std::to_string(i) + ".example";
+        queries.push_back(make_query(id, name));
+    }
+
+    int upstream_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    auto upstream_address = loopback(0);
+    bind(upstream_fd, reinterpret_cast<sockaddr*>(&upstream_address), sizeof(upstream_address));
+    socklen_t length = sizeof(upstream_address);
+    getsockname(upstream_fd, reinterpret_cast<sockaddr*>(&upstream_address), &length);
+
+    DNSServerConfig config;
+    config.listen_address = "127.0.0.1";
+    config.port = 0;
+    config.upstream = "127.0.0.1";
+    config.upstream_port = ntohs(upstream_address.sin_port);
+    config.default_security_level = 1;
+    DNSResponder responder(config, index);
+
+    std::atomic<bool> running{true};
+    std::thread server([&]() {
+        pin_to_core(options.core);
+        responder.serve();
+    });
+    std::thread upstream([&]() { run_upstream(upstream_fd, running); });
+
+    std::cout << "Responder pinned to core " << options.core << ", " << options.clients << " client(s), window "
+              << options.window << ", " << options.blocked_ratio * 100 << "% blocked, " << options.seconds
+              << "s..." << std::endl;
+
+    std::vector<std::thread> clients;
+    std::vector<uint64_t> answered(options.clients);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options.clients; ++i)
+        clients.emplace_back([&, i]() { answered[i] = run_client(responder.port(), queries, options.window, running); });
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+    running = false;
+    for (auto& client : clients) client.join();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    responder.stop();
+    server.join();
+    upstream.join();
+    close(upstream_fd);
+
+    uint64_t total = 0;
+    for (auto count : answered) total += count;
+    auto stats = responder.stats();
+
+    std::cout << "\nAnswered: " << total << " in " << elapsed << "s -> " << static_cast<uint64_t>(total / elapsed)
+              << " QPS\n"
+              << "Responder: queries " << stats.queries << ", blocked " << stats.blocked << ", forwarded "
+              << stats.forwarded << ", dropped " << stats.dropped << std::endl;
+    return 0;
+}
@@ -0,0 +1,314 @@
+#!/usr/bin/env python3
+# Stand-in for the FortiOS REST API endpoints forti-hole drives, so pushes can be exercised and benchmarked
+# without an appliance. Standard library only (plus the openssl CLI to mint a self-signed certificate).
+#
+#   python3 bench/fortigate_emulator.py [--port 8443] [--api-key KEY] [--latency-ms 20] [--jitter-ms 5]
+#                                       [--throughput-kbps 0] [--max-feed-entries 131072] [--overflow-rate 0]
+#
+# Serves:
+#   /api/v2/cmdb/<path>/<table>[/<mkey>]               GET, POST, PUT, DELETE on an in-memory store, which covers
+#                                                      system/external-resource, dnsfilter/profile, firewall/policy;
+#                                                      entries are keyed by name as the FortiOS REST API docs
+#                                                      describe (not yet checked against forti-api's requests),
+#                                                      policies are also reachable by policyid, and GET takes
+#                                                      ?filter=<field>==<value>
+#   /api/v2/monitor/system/external-resource/dynamic   POST, threat feed entry push (snapshot, add, remove)
+#   /api/v2/monitor/system/status                      GET
+#   /emulator/stats, /emulator/reset                   GET, POST; request counters for benchmarks
+#
+# Point a config.yaml at it with gateway_ip 127.0.0.1, the chosen port and api_key, and ca_cert_path set to the
+# certificate path printed on startup.
+#
+
+import argparse
+import json
+import os
+import random
+import ssl
+import subprocess
+import tempfile
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, unquote, urlsplit
+
+# tables whose entries also carry a numeric id, assigned on creation
+NUMERIC_IDS = {"firewall/policy": "policyid"}
+
+
+class Store:
+    def __init__(self, seed_policies):
+        self.lock = threading.RLock()  # result() counts errors while handlers hold it
+        self.tables = {}
+        self.feeds = {}
+        self.stats = {}
+        self.reset(seed_policies)
+
+    def reset(self, seed_policies):
+        with self.lock:
+            self.tables = {"firewall/policy": {}}
+            self.feeds = {}
+            self.stats = {"requests": 0, "errors": 0, "overflows": 0, "pushed_entries": 0, "pushed_bytes": 0}
+            for policyid, name in enumerate(seed_policies, start=1):
+                self.tables["firewall/policy"][name] = {"policyid": policyid, "name": name, "dnsfilter-profile": ""}
+
+    def table(self, path):
+        return self.tables.setdefault(path, {})
+
+    def resolve(self, path, mkey):
+        """Key of the entry mkey names, by name or (for tables with numeric ids) by id."""
+        table = self.table(path)
+        if mkey in table:
+            return mkey
+        id_field = NUMERIC_IDS.get(path)
+        if id_field:
+            for key, entry in table.items():
+                if str(entry.get(id_field)) == mkey:
+                    return key
+        return None
+
+
+class Handler(BaseHTTPRequestHandler):
+    server_version = "forti-hole-emulator"
+    protocol_version = "HTTP/1.1"
+
+    # quiet unless --verbose
+    def log_message(self, fmt, *args):
+        if self.server.options.verbose:
+            super().log_message(fmt, *args)
+
+    def do_GET(self):
+        self.handle_api("GET")
+
+    def do_POST(self):
+        self.handle_api("POST")
+
+    def do_PUT(self):
+        self.handle_api("PUT")
+
+    def do_DELETE(self):
+        self.handle_api("DELETE")
+
+    def reply(self, status, body):
+        data = json.dumps(body).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def result(self, method, path, results=None, status=200, **extra):
+        body = {"http_method": method, "path": path, "vdom": "root", "serial": "FGEMULATOR0000000",
+                "version": "v7.4.4", "build": 2662, "status": "success" if status < 400 else "error",
+                "http_status": status}
+        if results is not None:
+            body["results"] = results
+        body.update(extra)
+        if status >= 400:
+            with self.server.store.lock:
+                self.server.store.stats["errors"] += 1
+        self.reply(status, body)
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length") or 0)
+        data = self.rfile.read(length) if length else b""
+
+        # bandwidth cap on what the client sends, applied after the fact so slow links look slow end to end
+        kbps = self.server.options.throughput_kbps
+        if kbps > 0 and data:
+            time.sleep(len(data) * 8 / (kbps * 1000))
+
+        return json.loads(data) if data else {}
+
+    def authorized(self, query):
+        expected = self.server.options.api_key
+        if not expected:
+            return True
+        header = self.headers.get("Authorization", "")
+        token = header[len("Bearer "):] if header.startswith("Bearer ") else query.get("access_token", [""])[0]
+        return token == expected
+
+    def handle_api(self, method):
+        options, store = self.server.options, self.server.store
+        url = urlsplit(self.path)
+        query = parse_qs(url.query)
+        path = url.path.rstrip("/")
+
+        with store.lock:
+            store.stats["requests"] += 1
+
+        if path == "/emulator/stats":
+            with store.lock:
+                return self.reply(200, dict(store.stats, feeds={k: len(v) for k, v in store.feeds.items()}))
+        if path == "/emulator/reset":
+            store.reset(options.seed_policy)
+            return self.reply(200, {"status": "success"})
+
+        if not self.authorized(query):
+            return self.result(method, path, status=401)
+
+        try:
+            body = self.read_body() if method in ("POST", "PUT") else {}
+        except json.JSONDecodeError:
+            return self.result(method, path, status=400)
+
+        if options.latency_ms > 0 or options.jitter_ms > 0:
+            time.sleep(max(0.0, random.gauss(options.latency_ms, options.jitter_ms)) / 1000)
+
+        if path == "/api/v2/monitor/system/status":
+            return self.result(method, "system", {"hostname": "forti-hole-emulator", "model": "FGVMEM"})
+        if path == "/api/v2/monitor/system/external-resource/dynamic" and method == "POST":
+            return self.push_entries(body)
+        if path.startswith("/api/v2/cmdb/"):
+            return self.cmdb(method, path[len("/api/v2/cmdb/"):], body, query)
+
+        self.result(method, path, status=404)
+
+    def push_entries(self, body):
+        options, store = self.server.options, self.server.store
+        commands = body.get("commands", [])
+
+        # FortiOS rejects oversized pushes with a generic error after buffering the whole request
+        if options.overflow_rate > 0 and random.random() < options.overflow_rate:
+            with store.lock:
+                store.stats["overflows"] += 1
+            return self.result("POST", "system", status=500, error=-1, cli_error="buffer overflow")
+
+        with store.lock:
+            resources = store.table("system/external-resource")
+            for command in commands:
+                name = command.get("name", "")
+                if name not in resources:
+                    return self.result("POST", "system", status=404, error=-3, cli_error=f"unknown feed {name}")
+
+                entries = command.get("entries", [])
+                feed = store.feeds.setdefault(name, set())
+                action = command.get("command", "snapshot")
+                if action == "snapshot":
+                    feed.clear()
+                    feed.update(entries)
+                elif action == "add":
+                    feed.update(entries)
+                elif action == "remove":
+                    feed.difference_update(entries)
+                else:
+                    return self.result("POST", "system", status=400, cli_error=f"unknown command {action}")
+
+                if len(feed) > options.max_feed_entries:
+                    feed.clear()
+                    store.stats["overflows"] += 1
+                    return self.result("POST", "system", status=500, error=-1,
+                                       cli_error=f"feed {name} exceeds {options.max_feed_entries} entries")
+
+                store.stats["pushed_entries"] += len(entries)
+                store.stats["pushed_bytes"] += sum(len(entry) + 1 for entry in entries)
+
+        self.result("POST", "system", {"status": "success"})
+
+    def cmdb(self, method, rest, body, query):
+        store = self.server.store
+        parts = [unquote(part) for part in rest.split("/")]
+        if len(parts) < 2:
+            return self.result(method, rest, status=404)
+
+        path = "/".join(parts[:2])
+        mkey = "/".join(parts[2:]) or None
+        id_field = NUMERIC_IDS.get(path)
+
+        with store.lock:
+            table = store.table(path)
+
+            if method == "GET":
+                if mkey is None:
+                    entries = list(table.values())
+                    for condition in query.get("filter", []):
+                        field, _, value = condition.partition("==")
+                        entries = [entry for entry in entries if str(entry.get(field)) == value]
+                    return self.result(method, parts[0], entries, name=parts[1])
+                key = store.resolve(path, mkey)
+                if key is None:
+                    return self.result(method, parts[0], status=404, name=parts[1], mkey=mkey)
+                return self.result(method, parts[0], [table[key]], name=parts[1], mkey=mkey)
+
+            if method == "POST":
+                key = str(body.get("name", ""))
+                if not key:
+                    return self.result(method, parts[0], status=400, name=parts[1])
+                if key in table:
+                    return self.result(method, parts[0], status=500, error=-5, name=parts[1], mkey=key)
+                if id_field and not body.get(id_field):
+                    body[id_field] = max((entry.get(id_field, 0) for entry in table.values()), default=0) + 1
+                table[key] = body
+                return self.result(method, parts[0], name=parts[1], mkey=key)
+
+            key = store.resolve(path, mkey) if mkey is not None else None
+            if key is None:
+                return self.result(method, parts[0], status=404, name=parts[1], mkey=mkey)
+
+            if method == "PUT":
+                # a rename moves the entry to its new key
+                table[key].update(body)
+                new_key = str(table[key].get("name", key))
+                if new_key != key:
+                    table[new_key] = table.pop(key)
+                return self.result(method, parts[0], name=parts[1], mkey=mkey)
+
+            del table[key]
+            if path == "system/external-resource":
+                store.feeds.pop(key, None)
+            return self.result(method, parts[0], name=parts[1], mkey=mkey)
+
+
+def self_signed_certificate(directory):
+    cert, key = os.path.join(directory, "emulator.crt"), os.path.join(directory, "emulator.key")
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "30",
+                    "-subj", "/CN=localhost", "-addext", "subjectAltName=IP:127.0.0.1,DNS:localhost",
+                    "-keyout", key, "-out", cert], check=True, capture_output=True)
+    return cert, key
+
+
+def main():
+    parser = argparse.ArgumentParser(description="FortiGate REST API emulator for forti-hole")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--api-key", default="", help="required bearer token, empty accepts any")
+    parser.add_argument("--cert", help="PEM certificate, a self-signed one is generated when omitted")
+    parser.add_argument("--key", help="PEM private key for --cert")
+    parser.add_argument("--latency-ms", type=float, default=0, help="mean added latency per request")
+    parser.add_argument("--jitter-ms", type=float, default=0, help="standard deviation of the added latency")
+    parser.add_argument("--throughput-kbps", type=float, default=0, help="request body bandwidth cap, 0 is unlimited")
+    parser.add_argument("--max-feed-entries", type=int, default=131072, help="entries a single feed may hold")
+    parser.add_argument("--overflow-rate", type=float, default=0, help="probability a push fails with an overflow")
+    parser.add_argument("--seed-policy", action="append", default=[], help="firewall policy name to pre-create")
+    parser.add_argument("--seed", type=int, help="random seed for reproducible latency and failures")
+    parser.add_argument("--verbose", action="store_true")
+    options = parser.parse_args()
+
+    if options.seed is not None:
+        random.seed(options.seed)
+    if not options.seed_policy:
+        options.seed_policy = ["forti-hole-bench"]
+
+    cert, key = options.cert, options.key
+    if not cert:
+        cert, key = self_signed_certificate(tempfile.mkdtemp(prefix="forti-hole-emulator-"))
+
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(cert, key)
+
+    server = ThreadingHTTPServer((options.host, options.port), Handler)
+    server.daemon_threads = True
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    server.options = options
+    server.store = Store(options.seed_policy)
+
+    print(f"FortiGate emulator listening on https://{options.host}:{server.server_address[1]}", flush=True)
+    print(f"CA certificate: {cert}", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,155 @@
+// Load-test driver for gateway pushes, meant to run against bench/fortigate_emulator.py (or a lab FortiGate).
+// Pushes a synthetic build through Gateway a few times to time the full push phase, then re-uploads every
+// part on its own to report parts/sec and per-part latency percentiles.
+//
+//   push-bench --ca-cert FILE [--host 127.0.0.1] [--port 8443] [--api-key KEY] [--levels 2] [--parts 4]
+//              [--lines 131000] [--rounds 3] [--uploads 5]
+//
+
+#include "include/Gateway.h"
+#include <forti_api.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1", api_key, ca_cert;
+    unsigned int port = 8443, levels = 2, parts = 4, lines = 131000, rounds = 3, uploads = 5;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double milliseconds(Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0;
+    auto rank = static_cast<size_t>(p / 100.0 * static_cast<double>(samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + static_cast<long>(rank), samples.end());
+    return samples[rank];
+}
+
+void report(const std::string& label, const std::vector<double>& samples) {
+    std::cout << label << " ms: p50 " << percentile(samples, 50) << ", p90 " << percentile(samples, 90)
+              << ", p99 " << percentile(samples, 99) << ", max " << percentile(samples, 100) << std::endl;
+}
+
+ThreatFeedBuild synthetic_build(const Options& options, const Config& config) {
+    ThreatFeedBuild build;
+    unsigned int category = config.categories.base;
+    for (unsigned int level = 0; level < options.levels; ++level) {
+        build.info_by_security_level.emplace_back(options.parts * options.lines, options.parts, category);
+        category += options.parts;
+
+        auto& parts = build.parts_by_security_level.emplace_back();
+        for (unsigned int part = 0; part < options.parts; ++part) {
+            auto& lines = parts.emplace_back(
+                    ThreatFeedPart{config.naming_convention.file_name(level, part + 1), {}}).lines;
+            lines.reserve(options.lines);
+            for (unsigned int i = 0; i < options.lines; ++i)
+                lines.push_back("host" + std::to_string(i) + ".part-" + std::to_string(part) + ".level-"
+                                + std::to_string(level) + ".bench.example");
+        }
+    }
+    return build;
+}
+
+Config bench_config(const Options& options) {
+    Config config;
+    config.naming_convention = {"push-bench", "level", "part"};
+    config.categories = {192, 221, 192};
+
+    FortiHoleConfig filter;
+    filter.dns_filter = "forti-hole-bench";
+    filter.firewall_policies = {"forti-hole-bench"};  // pre-created by the emulator
+    for (unsigned int level = 0; level < options.levels; ++level) filter.filters.push_back({level, "block"});
+
+    GatewayConfig gateway;
+    gateway.name = options.host + ':' + std::to_string(options.port);
+    gateway.fortigate.gateway_ip = options.host;
+    gateway.fortigate.admin_https_port = options.port;
+    gateway.fortigate.api_key = options.api_key;
+    gateway.fortigate.certificates.ca_cert_path = options.ca_cert;
+    gateway.forti_hole_automated_dns_filters = {filter};
+    config.gateways = {gateway};
+    config.gateway_concurrency = 1;
+    return config;
+}
+
+Options parse(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--host") options.host = value;
+        else if (flag == "--port") options.port = std::stoul(value);
+        else if (flag == "--api-key") options.api_key = value;
+        else if (flag == "--ca-cert") options.ca_cert = value;
+        else if (flag == "--levels") options.levels = std::stoul(value);
+        else if (flag == "--parts") options.parts = std::stoul(value);
+        else if (flag == "--lines") options.lines = std::stoul(value);
+        else if (flag == "--rounds") options.rounds = std::stoul(value);
+        else if (flag == "--uploads") options.uploads = std::stoul(value);
+        else throw std::invalid_argument("Unknown option: " + flag);
+    }
+    if (options.levels * options.parts > 30) throw std::invalid_argument("levels * parts must fit in 30 categories");
+    return options;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    auto options = parse(argc, argv);
+    auto config = bench_config(options);
+
+    std::cout << "Building " << options.levels << " level(s) x " << options.parts << " part(s) x " << options.lines
+              << " lines..." << std::endl;
+    auto build = synthetic_build(options, config);
+
+    size_t part_bytes = 0;
+    for (const auto& line : build.parts_by_security_level.front().front().lines) part_bytes += line.size() + 1;
+
+    // full push phase: feed containers, every part, dns filters and policies
+    std::vector<double> rounds;
+    unsigned int failed_rounds = 0;
+    for (unsigned int round = 0; round < options.rounds; ++round) {
+        auto start = Clock::now();
+        try { Gateway(config.gateways.front(), config, build)(); }
+        catch (const std::exception& e) {
+            std::cerr << "Push round " << round + 1 << " failed: " << e.what() << std::endl;
+            ++failed_rounds;
+            continue;
+        }
+        rounds.push_back(milliseconds(Clock::now() - start));
+    }
+
+    // single part uploads, FortiAuth is still pointed at the gateway by the rounds above
+    std::vector<double> uploads;
+    unsigned int failed_uploads = 0;
+    auto start = Clock::now();
+    for (unsigned int pass = 0; pass < options.uploads; ++pass) {
+        for (const auto& parts : build.parts_by_security_level) {
+            for (const auto& part : parts) {
+                auto upload_start = Clock::now();
+                try { ThreatFeed::update_feed({{part.filename, part.lines}}); }
+                catch (const std::exception& e) {
+                    std::cerr << part.filename << ": " << e.what() << std::endl;
+                    ++failed_uploads;
+                    continue;
+                }
+                uploads.push_back(milliseconds(Clock::now() - upload_start));
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << std::fixed << std::setprecision(1) << '\n';
+    report("Full push (" + std::to_string(rounds.size()) + " ok, " + std::to_string(failed_rounds) + " failed)",
+           rounds);
+    report("Part upload (" + std::to_string(uploads.size()) + " ok, " + std::to_string(failed_uploads) + " failed)",
+           uploads);
+    std::cout << "Throughput: " << static_cast<double>(uploads.size()) / elapsed << " parts/s, "
+              << static_cast<double>(uploads.size() * part_bytes) / elapsed / (1024 * 1024) << " MiB/s" << std::endl;
+    return failed_rounds + failed_uploads > 0 ? 1 : 0;
+}
@@ -78,6 +78,13 @@ fi
 
 SERVICE_FILE="./install/forti-hole.service"
 TIMER_FILE="./install/forti-hole-5am.timer"
+
+# --dns installs the long-running DNS responder unit instead of the daily oneshot run and its timer
+if [[ "$1" == "--dns" ]]; then
+    SERVICE_FILE="./install/forti-hole-dns.service"
+    TIMER_FILE=""
+fi
+SERVICE_NAME="$(basename "$SERVICE_FILE")"
 SYSTEMD_PATH="/etc/systemd/system"
 RUN_SCRIPT_PATH="$(pwd)/bin/run.sh"
 WORKING_DIRECTORY="$(pwd)"
@@ -93,8 +100,10 @@ sed -i "s|ExecStart=.*|ExecStart=$RUN_SCRIPT_PATH|g" "$SERVICE_FILE" || { echo "
 echo "Copying $SERVICE_FILE to $SYSTEMD_PATH..."
 sudo cp "$SERVICE_FILE" "$SYSTEMD_PATH" || { echo "Failed to copy $SERVICE_FILE"; exit 1; }
 
-echo "Copying $TIMER_FILE to $SYSTEMD_PATH..."
-sudo cp "$TIMER_FILE" "$SYSTEMD_PATH" || { echo "Failed to copy $TIMER_FILE"; exit 1; }
+if [[ -n "$TIMER_FILE" ]]; then
+    echo "Copying $TIMER_FILE to $SYSTEMD_PATH..."
+    sudo cp "$TIMER_FILE" "$SYSTEMD_PATH" || { echo "Failed to copy $TIMER_FILE"; exit 1; }
+fi
 
 # Update ExecStart in the service file
 echo "Updating ExecStart line in $SERVICE_FILE with the correct path..."
@@ -119,13 +128,15 @@ echo "Reloading systemd daemon..."
 sudo systemctl daemon-reload || { echo "Failed to reload systemd"; exit 1; }
 
 # Enable and start the timer
-echo "Enabling and starting forti-hole-5am.timer..."
-sudo systemctl enable forti-hole-5am.timer || { echo "Failed to enable forti-hole-5am.timer"; exit 1; }
-sudo systemctl start forti-hole-5am.timer || { echo "Failed to start forti-hole-5am.timer"; exit 1; }
+if [[ -n "$TIMER_FILE" ]]; then
+    echo "Enabling and starting forti-hole-5am.timer..."
+    sudo systemctl enable forti-hole-5am.timer || { echo "Failed to enable forti-hole-5am.timer"; exit 1; }
+    sudo systemctl start forti-hole-5am.timer || { echo "Failed to start forti-hole-5am.timer"; exit 1; }
+fi
 
 # Enable and start the service
-echo "Enabling and starting forti-hole service..."
-sudo systemctl enable forti-hole.service || { echo "Failed to enable forti-hole service"; exit 1; }
-sudo systemctl start forti-hole.service || { echo "Failed to start forti-hole service"; exit 1; }
+echo "Enabling and starting $SERVICE_NAME..."
+sudo systemctl enable "$SERVICE_NAME" || { echo "Failed to enable $SERVICE_NAME"; exit 1; }
+sudo systemctl start "$SERVICE_NAME" || { echo "Failed to start $SERVICE_NAME"; exit 1; }
 
 echo "Installation and service setup completed successfully."
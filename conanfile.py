@@ -12,6 +12,7 @@ class Pkg(ConanFile):
     topics = ("c++", "security", "DNS blocklists", "Pi-hole")
     settings = "os", "compiler", "arch", "build_type"
     generators = "PkgConfigDeps", "MesonToolchain"
+    default_options = {"libcurl/*:with_brotli": True, "libcurl/*:with_zstd": True}
     exports_sources = "meson.build", "include/*", "main.cpp", "config.yaml"
     include = ['include']
     src = ['src']
@@ -27,6 +28,9 @@ class Pkg(ConanFile):
         self.requires('forti-api/0.2.0')
         self.requires('yaml-cpp/0.8.0')
         self.requires('libcurl/8.9.1')
+        self.requires('zlib/[>=1.2.11 <2]')
+        self.requires('zstd/[>=1.5 <1.6]')
+        self.requires('brotli/1.1.0')
         self.test_requires('gtest/1.14.0')
 
     def build(self):
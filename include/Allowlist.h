@@ -0,0 +1,49 @@
+#ifndef FORTI_HOLE_ALLOWLIST_H
+#define FORTI_HOLE_ALLOWLIST_H
+
+#include "include/config.h"
+#include "DomainIndex.h"
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Domains that must never be blocked, compiled once from the config:
+//   exact:    example.com                       matches only example.com
+//   suffix:   example.com                       matches example.com and every subdomain
+//   patterns: *.cdn.example.com, sso-??.corp.io  glob ('*' any run, '?' one character)
+//             /^ads[0-9]+\.example\.net$/      ECMAScript regex, all of them merged into one alternation
+// Exact and suffix rules cost one hash probe per label, the same scheme as DomainIndex. Globs are pre-filtered
+// by their literal tail; the merged regex only runs when one is configured.
+class Allowlist {
+    struct Glob {
+        std::string pattern, tail;
+    };
+
+    DomainIndex exact, suffix;
+    std::vector<Glob> globs;
+    std::optional<std::regex> regex;
+
+    static bool glob_match(std::string_view pattern, std::string_view domain);
+
+public:
+    Allowlist() = default;
+    explicit Allowlist(const AllowlistConfig& config);
+
+    void allow_suffix(std::string_view domain) { suffix.insert(domain); }
+
+    [[nodiscard]] bool empty() const { return exact.size() == 0 && suffix.size() == 0 && globs.empty() && !regex; }
+    [[nodiscard]] bool allows(std::string_view domain) const;
+};
+
+// '@@||domain^' exception rules collected from the sources while they are parsed.
+// They apply across every list, so they can only be enforced once parsing has finished.
+struct SourceExceptions {
+    std::mutex mutex;
+    std::unordered_set<std::string> domains;
+};
+
+#endif //FORTI_HOLE_ALLOWLIST_H
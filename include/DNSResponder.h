@@ -0,0 +1,141 @@
+#ifndef FORTI_HOLE_DNS_RESPONDER_H
+#define FORTI_HOLE_DNS_RESPONDER_H
+
+#ifdef __linux__
+
+#include "include/config.h"
+#include "Allowlist.h"
+#include "DomainIndex.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// Single-threaded epoll DNS sinkhole (Linux only). Blocked names (per the client's security level) are answered locally with
+// NXDOMAIN or 0.0.0.0/::, unless the allowlist allows the exact name; everything else is relayed to the upstream resolver over one connected UDP socket under a
+// random query ID, and answers are only relayed back when their ID and question match an outstanding query.
+// UDP traffic is moved in recvmmsg/sendmmsg batches. TCP clients are served from the same loop and relayed over a
+// TCP connection of their own to the upstream, so answers too large for UDP reach them in full.
+class DNSResponder {
+public:
+    struct Stats {
+        uint64_t queries, blocked, forwarded, dropped;
+    };
+
+private:
+    static constexpr size_t BATCH_SIZE = 64;
+    static constexpr size_t MAX_UDP_MESSAGE = 4096;
+    static constexpr size_t MAX_REPLY = 512;
+    static constexpr size_t MAX_TCP_CONNECTIONS = 1024;
+    static constexpr size_t MAX_TCP_BUFFER = 1 << 20;
+
+    enum class Action { Reply, Forward, Drop };
+
+    struct ClientRange {
+        uint32_t network, mask;
+        unsigned int security_level;
+    };
+
+    struct Pending {
+        sockaddr_in client;
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t question;  // see question_hash, answers must echo it
+        uint16_t client_id;
+        bool active;
+    };
+
+    // a client, or the upstream connection relaying that client's queries; each names the other as its peer
+    struct TcpConnection {
+        int fd;
+        std::string in, out;
+        uint64_t peer;  // 0 until the client forwards its first query
+        bool upstream;
+    };
+
+    // swapped as one, so a refresh never pairs one build's index with another build's allowlist
+    struct Lists {
+        std::shared_ptr<const DomainIndex> index;
+        std::shared_ptr<const Allowlist> allowlist;  // may be null
+    };
+
+    struct Batch {
+        std::array<std::array<uint8_t, MAX_UDP_MESSAGE>, BATCH_SIZE> buffers{};
+        std::array<sockaddr_in, BATCH_SIZE> addresses{};
+        std::array<iovec, BATCH_SIZE> iovecs{};
+        std::array<mmsghdr, BATCH_SIZE> headers{};
+    };
+
+    DNSServerConfig config;
+    std::atomic<std::shared_ptr<const Lists>> lists;
+    std::vector<ClientRange> clients;
+    bool null_mode;
+
+    int epoll_fd{-1}, udp_fd{-1}, tcp_fd{-1}, upstream_fd{-1}, stop_fd{-1};
+    uint16_t bound_port{};
+    sockaddr_in upstream_address{};
+
+    std::vector<Pending> pending;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, uint16_t>> pending_order;
+    std::array<uint16_t, 256> random_ids{};
+    size_t random_ids_left{};
+    size_t pending_count{};
+
+    std::unordered_map<uint64_t, TcpConnection> tcp_connections;
+    uint64_t next_connection;
+
+    std::unique_ptr<Batch> inbound, replies, relays;
+
+    std::atomic<uint64_t> queries{}, blocked{}, forwarded{}, dropped{};
+
+    void open_sockets();
+    void close_sockets();
+
+    [[nodiscard]] unsigned int security_level_for(uint32_t client_ip) const;
+    Action handle_query(const Lists& domains, const uint8_t* query, size_t length, uint32_t client_ip,
+                        uint8_t* reply, size_t& reply_length);
+    uint16_t random_id();
+    bool register_pending(uint8_t* query, size_t length, const sockaddr_in& client);
+    void send_batch(int fd, Batch& batch, unsigned int count);
+    void expire_pending();
+
+    void drain_udp();
+    void drain_upstream();
+
+    void accept_tcp();
+    uint64_t add_tcp(int fd, bool upstream);
+    void read_tcp(uint64_t connection);
+    void forward_tcp(uint64_t connection, const uint8_t* query, size_t length);
+    void send_tcp(uint64_t connection, const uint8_t* message, size_t length);
+    void flush_tcp(uint64_t connection);
+    void close_tcp(uint64_t connection);
+
+public:
+    // allowlist catches names the index would block through a parent domain, e.g. an allowed login.example.com
+    // under a blocked example.com, or a source's '@@' exception for a subdomain of a blocked one
+    DNSResponder(const DNSServerConfig& config, std::shared_ptr<const DomainIndex> index,
+                 std::shared_ptr<const Allowlist> allowlist = nullptr);
+    ~DNSResponder();
+
+    DNSResponder(const DNSResponder& rhs) = delete;
+    DNSResponder& operator=(const DNSResponder& rhs) = delete;
+
+    // swaps in a freshly built index and allowlist without interrupting service
+    void set_index(std::shared_ptr<const DomainIndex> next, std::shared_ptr<const Allowlist> allowlist = nullptr);
+
+    void serve();
+    void stop();
+
+    [[nodiscard]] uint16_t port() const { return bound_port; }
+    [[nodiscard]] Stats stats() const;
+};
+
+#endif // __linux__
+
+#endif //FORTI_HOLE_DNS_RESPONDER_H
@@ -0,0 +1,50 @@
+#ifndef FORTI_HOLE_DECOMPRESSOR_H
+#define FORTI_HOLE_DECOMPRESSOR_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+struct z_stream_s;
+struct ZSTD_DCtx_s;
+struct BrotliDecoderStateStruct;
+
+// Streaming decoder for blocklists published as compressed files (.gz, .zst, .br).
+// Input is consumed as it arrives from the network and only decoded text is kept, through a fixed scratch buffer.
+// HTTP Content-Encoding is handled by libcurl itself; this covers the file format, not the transfer. Servers that
+// label a compressed file with a matching Content-Encoding have it undone by libcurl, which declare_encoding()
+// accounts for. gzip and zstd input is also checked for its magic bytes, brotli has none to check.
+class Decompressor {
+public:
+    enum class Format { None, Gzip, Zstd, Brotli };
+
+private:
+    Format format;
+    bool sniffed{}, finished{};
+    std::string prefix;  // input held back until the magic bytes can be checked
+    std::unique_ptr<z_stream_s, void(*)(z_stream_s*)> gzip;
+    std::unique_ptr<ZSTD_DCtx_s, void(*)(ZSTD_DCtx_s*)> zstd;
+    std::unique_ptr<BrotliDecoderStateStruct, void(*)(BrotliDecoderStateStruct*)> brotli;
+
+    void feed_gzip(const unsigned char* data, size_t length, std::string& out);
+    void feed_zstd(const unsigned char* data, size_t length, std::string& out);
+    void feed_brotli(const unsigned char* data, size_t length, std::string& out);
+
+public:
+    explicit Decompressor(Format format);
+
+    static Format from_path(std::string_view path);
+
+    // the response's Content-Encoding header, call before the first feed(); passes the body through as is when
+    // it names this format
+    void declare_encoding(std::string_view content_encoding);
+
+    // appends the decoded form of the next chunk to out, throws std::runtime_error on corrupt input
+    void feed(const char* data, size_t length, std::string& out);
+
+    // throws if the compressed stream was cut short
+    void finish() const;
+};
+
+#endif //FORTI_HOLE_DECOMPRESSOR_H
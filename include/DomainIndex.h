@@ -0,0 +1,55 @@
+#ifndef FORTI_HOLE_DOMAIN_INDEX_H
+#define FORTI_HOLE_DOMAIN_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+struct ThreatFeedBuild;
+
+// Read-only map of blocked domain -> lowest security level that blocks it, answering "is this name or any
+// parent domain blocked" with one probe per label. Open addressing over 16-byte slots keeps probes in a
+// single cache line; the domain text lives in one contiguous arena and is only touched on a hash hit.
+class DomainIndex {
+    struct Slot {
+        uint64_t hash;
+        uint32_t offset;
+        uint16_t length;
+        uint8_t security_level;
+        uint8_t used;
+    };
+
+    std::vector<Slot> slots;
+    std::string arena;
+    size_t mask{}, count{};
+
+    void reserve(size_t domains);
+    void grow();
+    [[nodiscard]] const Slot* find(uint64_t hash, std::string_view domain) const;
+
+public:
+    static constexpr uint8_t NOT_BLOCKED = UINT8_MAX;
+
+    DomainIndex() = default;
+    explicit DomainIndex(size_t expected_domains) { reserve(expected_domains); }
+    explicit DomainIndex(const std::vector<std::unordered_set<std::string>>& lists_by_security_level);
+    explicit DomainIndex(const ThreatFeedBuild& build);
+
+    void insert(std::string_view domain, unsigned int security_level = 0);
+
+    // exact match only, parent domains are not considered
+    [[nodiscard]] bool contains(std::string_view domain) const;
+
+    // lowest security level blocking qname or one of its parent domains, NOT_BLOCKED otherwise
+    [[nodiscard]] uint8_t lookup(std::string_view qname) const;
+
+    [[nodiscard]] bool blocks(std::string_view qname, unsigned int security_level) const {
+        return lookup(qname) <= security_level;
+    }
+
+    [[nodiscard]] size_t size() const { return count; }
+};
+
+#endif //FORTI_HOLE_DOMAIN_INDEX_H
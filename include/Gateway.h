@@ -0,0 +1,45 @@
+#ifndef FORTI_HOLE_GATEWAY_H
+#define FORTI_HOLE_GATEWAY_H
+
+#include "include/config.h"
+#include "Task.h"
+#include "Journal.h"
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Pushes a precomputed ThreatFeedBuild to a single FortiGate.
+// Progress is journaled per gateway, so a resumed run skips the phases and parts that already landed.
+// forti-api keeps its credentials in process-global state, so a Gateway must own the process (or at least
+// the FortiAuth settings) for the duration of operator().
+class Gateway {
+    const GatewayConfig& gateway;
+    const Config& config;
+    const ThreatFeedBuild& build;
+    Journal journal;
+
+    void authenticate() const;
+    void create_threat_feeds() const;
+    void update_threat_feeds();
+    void enable_filters_and_policies() const;
+
+    void remove_extra_files(unsigned int security_level, unsigned int file_index) const;
+    void remove_all_custom_threat_feeds() const;
+
+    [[nodiscard]] std::ostream& log(std::ostream& os = std::cout) const;
+
+public:
+    Gateway(const GatewayConfig& gateway, const Config& config, const ThreatFeedBuild& build,
+            const std::filesystem::path& journal_path = {});
+
+    void operator()();
+};
+
+// Runs job(0) .. job(jobs - 1) in forked children, at most concurrency at a time, and returns their exit codes
+// (128 + signal for children that were killed, -1 where fork() failed). The caller must not hold locks that
+// a child could need, children only ever leave through _exit().
+std::vector<int> run_forked(size_t jobs, size_t concurrency, const std::function<int(size_t)>& job);
+
+#endif //FORTI_HOLE_GATEWAY_H
@@ -0,0 +1,54 @@
+#ifndef FORTI_HOLE_JOURNAL_H
+#define FORTI_HOLE_JOURNAL_H
+
+#include "Task.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Durable record of what a run has finished, rewritten atomically (tmp + fsync + rename) on every change.
+// A default constructed Journal is memory-only, which is what runs with journaling disabled use.
+class Journal {
+    std::filesystem::path path;
+    nlohmann::json state;
+
+    void persist() const;
+
+public:
+    Journal() : state(nlohmann::json::object()) {}
+    explicit Journal(std::filesystem::path path);
+
+    void reset(nlohmann::json header = nlohmann::json::object());
+    void remove();
+
+    [[nodiscard]] bool exists() const { return !state.empty(); }
+    [[nodiscard]] const nlohmann::json& header() const;
+
+    // a built but unfinished run of the same config that started at most max_age before now
+    [[nodiscard]] bool resumable(uint64_t config_hash, std::chrono::seconds max_age,
+                                 std::chrono::system_clock::time_point now = std::chrono::system_clock::now()) const;
+
+    [[nodiscard]] bool has_phase(const std::string& phase) const;
+    void complete_phase(const std::string& phase);
+
+    [[nodiscard]] bool has_part(const std::string& filename, uint64_t hash) const;
+    void record_part(const std::string& filename, uint64_t hash);
+
+    // the parts that did not land yet with their current content, in order
+    [[nodiscard]] std::vector<const ThreatFeedPart*> unpushed_parts(const std::vector<ThreatFeedPart>& parts) const;
+
+    static uint64_t part_hash(const std::vector<std::string>& lines);
+};
+
+// Finished ThreatFeedBuild persisted next to the journal so a resumed run can skip fetching and parsing.
+namespace BuildCache {
+    void save(const std::filesystem::path& dir, const ThreatFeedBuild& build);
+    std::optional<ThreatFeedBuild> load(const std::filesystem::path& dir);
+}
+
+void write_file_atomically(const std::filesystem::path& path, std::string_view data);
+
+#endif //FORTI_HOLE_JOURNAL_H
@@ -0,0 +1,31 @@
+#ifndef FORTI_HOLE_MAPPED_FILE_H
+#define FORTI_HOLE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// Read-only memory map of a local blocklist, so parsers work straight out of the page cache.
+// The kernel is told the mapping is read front to back (readahead starts immediately, pages behind the
+// reader can be dropped early), which is how the parse tasks walk their chunks.
+class MappedFile {
+    const char* data{};
+    size_t length{};
+
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] std::string_view view() const { return {data, length}; }
+    [[nodiscard]] size_t size() const { return length; }
+
+    static size_t page_size();
+};
+
+#endif //FORTI_HOLE_MAPPED_FILE_H
@@ -0,0 +1,46 @@
+#ifndef FORTI_HOLE_RESOURCE_GOVERNOR_H
+#define FORTI_HOLE_RESOURCE_GOVERNOR_H
+
+#include "include/config.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Command line overrides for the 'resources' config section, unset fields keep the config value.
+struct ResourceOverrides {
+    std::optional<unsigned int> threads, memory_limit_mb, io_priority_level;
+    std::optional<int> nice;
+    std::optional<std::vector<unsigned int>> cpu_affinity;
+    std::optional<std::string> io_priority_class;
+
+    void apply_to(ResourceConfig& resources) const;
+};
+
+// Keeps forti-hole a well-behaved batch job inside CPU-quota'd containers and on shared hosts.
+// The memory cap covers the whole process. Affinity, nice and io priority are per thread on Linux, so they go to
+// every thread of the run except the DNS responder's, which keeps its normal scheduling.
+namespace ResourceGovernor {
+    // effective limits of this process' cgroup and its ancestors, v2 or v1; the paths are parameters for tests.
+    // Values that do not parse count as no limit.
+    std::optional<double> cgroup_cpu_limit(const std::filesystem::path& root = "/sys/fs/cgroup",
+                                           const std::filesystem::path& self = "/proc/self/cgroup");  // in CPUs
+    std::optional<uint64_t> cgroup_memory_limit(const std::filesystem::path& root = "/sys/fs/cgroup",
+                                                 const std::filesystem::path& self = "/proc/self/cgroup");
+
+    // CPUs this process may be scheduled on
+    unsigned int available_cpus();
+
+    // validates resources and applies the memory cap, returns the worker count to use
+    unsigned int apply(const ResourceConfig& resources);
+
+    // affinity, nice and io priority for the calling thread; threads and processes it starts later inherit them
+    void apply_to_thread(const ResourceConfig& resources);
+
+    // digits only, so "-1" is rejected instead of wrapping around
+    unsigned int parse_unsigned(const std::string& value);
+    std::vector<unsigned int> parse_cpu_list(const std::string& list);
+}
+
+#endif //FORTI_HOLE_RESOURCE_GOVERNOR_H
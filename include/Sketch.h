@@ -0,0 +1,98 @@
+#ifndef FORTI_HOLE_SKETCH_H
+#define FORTI_HOLE_SKETCH_H
+
+#include "hash.h"
+#include <nlohmann/json.hpp>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// fnv1a alone leaves the high bits poorly mixed for short keys, both sketches index by them
+inline uint64_t sketch_hash(std::string_view domain) {
+    uint64_t hash = fnv1a_64(domain);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+// Distinct-count estimate in 16 KiB, ~0.8% standard error, mergeable.
+class HyperLogLog {
+public:
+    static constexpr unsigned int PRECISION = 14;
+    static constexpr size_t REGISTERS = size_t{1} << PRECISION;
+
+private:
+    std::vector<uint8_t> registers;
+
+public:
+    HyperLogLog() : registers(REGISTERS) {}
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLog& other);
+    [[nodiscard]] double estimate() const;
+};
+
+// One-permutation MinHash: a single hash per domain picks a bin and competes for its minimum,
+// so the hot path pays one comparison instead of one hash per permutation.
+class MinHash {
+public:
+    static constexpr size_t BINS = 256;
+
+private:
+    std::array<uint64_t, BINS> minimums;
+
+public:
+    MinHash() { minimums.fill(std::numeric_limits<uint64_t>::max()); }
+
+    void add(uint64_t hash) {
+        auto& minimum = minimums[hash % BINS];
+        if (hash / BINS < minimum) minimum = hash / BINS;
+    }
+
+    void merge(const MinHash& other);
+    [[nodiscard]] double jaccard(const MinHash& other) const;
+};
+
+// Everything one source listed. Parse tasks sketch their chunk locally and merge once.
+struct DomainSketch {
+    HyperLogLog domains;
+    MinHash minhash;
+
+    void add(uint64_t hash) {
+        domains.add(hash);
+        minhash.add(hash);
+    }
+
+    void merge(const DomainSketch& other);
+};
+
+struct SourceSketch {
+    std::string source;
+    unsigned int security_level{};
+    std::mutex mutex;
+    DomainSketch sketch;
+
+    SourceSketch(std::string source, unsigned int security_level) :
+            source(std::move(source)), security_level(security_level) {}
+};
+
+// Per source: estimated domains, domains no source at a lower security level lists (contributed), domains no
+// other source lists (exclusive), and its most similar sources: at most max_overlaps, each overlapping at least
+// min_jaccard, as {index, source, jaccard} so sources sharing a name stay apart. Computed from the finished
+// sketches alone, so the result does not depend on how parsing was scheduled.
+nlohmann::json source_report(const std::vector<std::shared_ptr<SourceSketch>>& sketches, double min_jaccard,
+                             size_t max_overlaps = 5);
+
+// Writes the report with the full pairwise Jaccard matrix ("jaccard", indexed like "sources"), one row at a time
+// so only a single row is ever held in memory.
+void write_source_report(const std::filesystem::path& path, const nlohmann::json& report,
+                         const std::vector<std::shared_ptr<SourceSketch>>& sketches);
+
+#endif //FORTI_HOLE_SKETCH_H
@@ -12,6 +12,13 @@
 #include <mutex>
 #include <unordered_set>
 #include <regex>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include "Allowlist.h"
+#include "MappedFile.h"
+#include "Sketch.h"
 
 using ExpectedFuture = std::variant<bool, std::pair<std::string, std::vector<std::string>>>;
 
@@ -21,7 +28,11 @@ inline static const std::regex valid_dns_regex{R"(^([a-zA-Z0-9-]+\.)*[a-zA-Z0-9-
 struct FortiHoleRequest {
     std::string url;
     unsigned int security_level;
-    std::string response;
+    std::string response{};
+    std::shared_ptr<const MappedFile> mapping{};  // uncompressed local lists are parsed in place
+    std::string source{};  // '<name_prefix>/<name>', labels the source in the overlap report
+
+    [[nodiscard]] std::string_view content() const { return mapping ? mapping->view() : std::string_view(response); }
 };
 
 struct ThreatFeedInfo {
@@ -33,39 +44,82 @@ struct ThreatFeedInfo {
             category_base(category_base) {}
 };
 
+struct ThreatFeedPart {
+    std::string filename;
+    std::vector<std::string> lines;
+};
+
+// every part of every security level, computed once per run and shared by all gateways
+struct ThreatFeedBuild {
+    std::vector<ThreatFeedInfo> info_by_security_level;
+    std::vector<std::vector<ThreatFeedPart>> parts_by_security_level;
+    std::vector<std::string> source_exceptions;  // '@@' rules the parts were filtered with, sorted
+};
+
 struct Task {
     virtual ~Task() = default;
     virtual ExpectedFuture operator()() = 0;
+
+    // labels the task in traces, payload is bytes for parsers and lines for builders
+    [[nodiscard]] virtual const char* name() const { return "Task"; }
+    [[nodiscard]] virtual size_t payload_size() const { return 0; }
 };
 
+// Parses [start, end) of a request's content in place, the request must outlive the task.
 struct ResponseParser : public Task {
     std::shared_ptr<std::vector<std::unordered_set<std::string>>> lists_by_security_level;
-    FortiHoleRequest request;
-    unsigned int start, end;
+    std::string_view content;
+    unsigned int security_level;
+    size_t start, end;
     std::shared_ptr<std::vector<std::mutex>> locks;
+    std::shared_ptr<const Allowlist> allowlist;
+    std::shared_ptr<SourceExceptions> exceptions;  // null when '@@' rules are not honored
+    std::shared_ptr<SourceSketch> sketch;  // null when the source report is disabled
 
     ResponseParser(const std::shared_ptr<std::vector<std::unordered_set<std::string>>>& lists,
-                   FortiHoleRequest request,
-                   unsigned int start,
-                   unsigned int end,
-                   const std::shared_ptr<std::vector<std::mutex>>& locks) :
+                   const FortiHoleRequest& request,
+                   size_t start,
+                   size_t end,
+                   const std::shared_ptr<std::vector<std::mutex>>& locks,
+                   const std::shared_ptr<const Allowlist>& allowlist,
+                   const std::shared_ptr<SourceExceptions>& exceptions,
+                   const std::shared_ptr<SourceSketch>& sketch = nullptr) :
                    lists_by_security_level(lists),
-                   request(std::move(request)),
+                   content(request.content()),
+                   security_level(request.security_level),
                    start(start),
                    end(end),
-                   locks(locks) {}
+                   locks(locks),
+                   allowlist(allowlist),
+                   exceptions(exceptions),
+                   sketch(sketch) {}
+
+    [[nodiscard]] const char* name() const override { return "ResponseParser"; }
+    [[nodiscard]] size_t payload_size() const override { return end - start; }
 
     ExpectedFuture operator()() override {
-        auto& content = request.response;
-        auto start_it = content.cbegin() + start;
-        auto end_it = content.cbegin() + end;
+        // sketched locally, one merge per task keeps the shared sketch off the hot path
+        std::unique_ptr<DomainSketch> local = sketch ? std::make_unique<DomainSketch>() : nullptr;
 
-        std::smatch matches;
-        std::string::const_iterator searchStart(start_it);
+        const char* end_it = content.data() + end;
+
+        std::cmatch matches;
+        const char* searchStart = content.data() + start;
         while (std::regex_search(searchStart, end_it, matches, domain_regex)) {
             std::string domain = matches[1].str();
 
-            unsigned int lower_security_levels = request.security_level;
+            // '@@||domain^' is an exception rule, never a block rule
+            auto rule_start = matches[0].first;
+            if (rule_start - content.data() >= 2 && *(rule_start - 1) == '@' && *(rule_start - 2) == '@') {
+                searchStart = matches.suffix().first;
+                if (exceptions) {
+                    std::scoped_lock lock(exceptions->mutex);
+                    exceptions->domains.insert(std::move(domain));
+                }
+                continue;
+            }
+
+            unsigned int lower_security_levels = security_level;
             bool match_found = false;
             while (lower_security_levels > 0) {
                 if (lists_by_security_level->at(--lower_security_levels).contains(domain)) {
@@ -76,41 +130,75 @@ struct ResponseParser : public Task {
 
             searchStart = matches.suffix().first;  // Move the searchStart iterator
 
-            if (match_found) continue;
+            // lower levels only hold valid, non-allowlisted domains
+            if (match_found) {
+                if (local) local->add(sketch_hash(domain));
+                continue;
+            }
+
+            if (allowlist->allows(domain)) continue;
             else if (std::regex_match(domain, valid_dns_regex)) {
+                if (local) local->add(sketch_hash(domain));
                 {
-                    std::scoped_lock lock(locks->at(request.security_level));
-                    lists_by_security_level->at(request.security_level).insert(domain);
+                    std::scoped_lock lock(locks->at(security_level));
+                    lists_by_security_level->at(security_level).insert(domain);
                 }
             }
         }
 
+        if (local) {
+            std::scoped_lock lock(sketch->mutex);
+            sketch->sketch.merge(*local);
+        }
+
         return true;  // dummy response for std::variant
     }
 };
 
+// Copies one part of a level's list, starting at first (see part_starts), into a threat feed file.
 struct ThreatFeedBuilder : public Task {
+    using Iterator = std::unordered_set<std::string>::const_iterator;
+
     std::shared_ptr<std::vector<std::unordered_set<std::string>>> lists_by_security_level;
     std::string filename;
     ThreatFeedInfo info;
     unsigned int security_level, file_index;
+    Iterator first;
     std::vector<std::string> to_upload;
 
     ThreatFeedBuilder(const std::shared_ptr<std::vector<std::unordered_set<std::string>>>& lists,
                       const std::string& filename,
                       const ThreatFeedInfo& info,
                       unsigned int security_level,
-                      unsigned int file_index) :
+                      unsigned int file_index,
+                      Iterator first) :
             lists_by_security_level(lists),
             filename(filename),
             info(info),
             security_level(security_level),
             file_index(file_index),
+            first(first),
             to_upload() { to_upload.reserve(info.lines_per_file + 1); }
 
+    // where each part of list starts, found in one walk over the set instead of one std::next per part
+    static std::vector<Iterator> part_starts(const std::unordered_set<std::string>& list, const ThreatFeedInfo& info) {
+        std::vector<Iterator> starts;
+        starts.reserve(info.file_count);
+        auto iter = list.cbegin();
+        for (size_t file_index = 0; file_index < info.file_count; ++file_index) {
+            starts.push_back(iter);
+            size_t count = info.lines_per_file + (file_index < info.extra ? 1 : 0);
+            for (size_t j = 0; j < count && iter != list.cend(); ++j) ++iter;
+        }
+        return starts;
+    }
+
+    [[nodiscard]] const char* name() const override { return "ThreatFeedBuilder"; }
+    [[nodiscard]] size_t payload_size() const override { return info.lines_per_file + (file_index < info.extra ? 1 : 0); }
+
     ExpectedFuture operator()() override {
-        auto iter = lists_by_security_level->at(security_level).begin();
-        auto end = lists_by_security_level->at(security_level).end();
+        auto end = lists_by_security_level->at(security_level).cend();
+        auto iter = first;
 
         size_t count = info.lines_per_file + (file_index < info.extra ? 1 : 0);
         for (size_t j = 0; j < count; ++j) {
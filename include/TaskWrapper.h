@@ -5,6 +5,7 @@
 #ifndef TSP_TASKWRAPPER_H
 #define TSP_TASKWRAPPER_H
 
+#include <cstdint>
 #include <memory>
 #include <future>
 #include "Task.h"
@@ -14,6 +15,7 @@ struct Task;
 class TaskWrapper {
     std::unique_ptr<Task> task;
     std::promise<ExpectedFuture> promise{};
+    int64_t enqueued{-1};  // Tracer timestamp, only taken while tracing
 
 public:
     TaskWrapper() = default;
@@ -25,6 +27,8 @@ public:
     TaskWrapper& operator=(TaskWrapper&& other) noexcept;
     void operator()();
 
+    void mark_enqueued();
+
     std::future<ExpectedFuture> getFuture();
 };
 
@@ -22,11 +22,14 @@ class ThreadPool {
     std::condition_variable cv;
     std::queue<TaskWrapper> queue;
     std::mutex mutex;
+    std::function<void()> on_worker_start;
 
     void worker();
 
 public:
-    ThreadPool();
+    // on_worker_start runs first thing on every worker thread, e.g. to set its scheduling attributes
+    explicit ThreadPool(unsigned int num_threads = std::thread::hardware_concurrency(),
+                        std::function<void()> on_worker_start = {});
     ~ThreadPool();
 
     ThreadPool(const ThreadPool& rhs);
@@ -35,6 +38,8 @@ public:
 
     void stop();
     void submit(TaskWrapper& task);
+
+    [[nodiscard]] unsigned int size() const { return numThreads; }
 };
 
 #endif // THREAD_MANAGER_H
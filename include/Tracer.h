@@ -0,0 +1,59 @@
+#ifndef FORTI_HOLE_TRACER_H
+#define FORTI_HOLE_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Opt-in timeline of pool tasks, pipeline phases and uploads, exported as Chrome/Perfetto trace JSON
+// (open it in ui.perfetto.dev or chrome://tracing). Each thread appends to its own buffer without locking,
+// a disabled tracer costs one relaxed atomic load per call site.
+namespace Tracer {
+    namespace detail { inline std::atomic<bool> enabled_flag{false}; }
+
+    [[nodiscard]] inline bool enabled() { return detail::enabled_flag.load(std::memory_order_relaxed); }
+
+    // starts recording, flush() writes everything recorded so far to path; events of threads that have exited are
+    // kept until one flush has written them, so long-lived processes recreating pools stay bounded
+    void enable(const std::filesystem::path& path);
+
+    // steady clock nanoseconds, shared by forked children so their files line up with the parent's
+    [[nodiscard]] int64_t now();
+
+    void set_thread_name(std::string name);
+
+    // queued is the enqueue timestamp of pool tasks, negative for everything else
+    void record(const char* name, const char* category, int64_t start, int64_t end,
+                uint64_t payload = 0, int64_t queued = -1, std::string_view detail = {});
+
+    void flush();
+
+    // called in a forked child: drops the parent's events, writes to '<trace>.<suffix>.json' instead (suffix made
+    // filename safe by file_safe_name()) and names its process 'forti-hole <suffix>' in the timeline
+    void after_fork(std::string_view suffix);
+
+    // records [construction, destruction) when the tracer was enabled at construction
+    class Span {
+        const char* name;
+        const char* category;
+        int64_t start;
+        uint64_t payload;
+        std::string detail;
+
+    public:
+        Span(const char* name, const char* category, std::string_view detail = {}, uint64_t payload = 0) :
+                name(name), category(category), start(enabled() ? now() : -1), payload(payload),
+                detail(start < 0 ? std::string_view{} : detail) {}
+
+        ~Span() { if (start >= 0) record(name, category, start, now(), payload, -1, detail); }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        void set_payload(uint64_t size) { payload = size; }
+    };
+}
+
+#endif //FORTI_HOLE_TRACER_H
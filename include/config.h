@@ -10,6 +10,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <format>
 
 inline static nlohmann::json yamlToJson(const YAML::Node& node) {
     nlohmann::json json;
@@ -53,11 +54,15 @@ struct Source {
     NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Source, name, security_level);
 };
 
+// url may be 'file:///path' for lists on local disk. directory adds every file below it (e.g. an rsync'd mirror)
+// at security_level, without listing them under sources.
 struct Blocklist {
-    std::string name_prefix, url, postfix;
+    std::string name_prefix, url, postfix, extension{".txt"}, directory;
+    unsigned int security_level{};
     std::vector<Source> sources;
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Blocklist, name_prefix, url, postfix, sources);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Blocklist, name_prefix, url, postfix, extension, directory,
+                                                security_level, sources);
 };
 
 struct Categories {
@@ -69,6 +74,11 @@ struct Categories {
 struct NamingConvention {
     std::string prefix, security_level, file_index;
 
+    [[nodiscard]] std::string file_name(unsigned int security_level_value, unsigned int file_index_value) const {
+        return std::format("{}_{}-{}_{}-{}", prefix, security_level, security_level_value,
+                           file_index, file_index_value);
+    }
+
     NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(NamingConvention, prefix, security_level, file_index)
 };
 
@@ -87,6 +97,69 @@ struct FortiGateConfig {
                                                 certificates)
 };
 
+struct JournalConfig {
+    bool enabled{false};
+    std::string directory{".forti-hole"};
+    unsigned int max_resume_age_minutes{180};
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(JournalConfig, enabled, directory, max_resume_age_minutes)
+};
+
+struct ResourceConfig {
+    unsigned int threads{};  // 0 derives the count from the cgroup CPU quota and CPU affinity
+    std::vector<unsigned int> cpu_affinity;
+    unsigned int memory_limit_mb{};
+    int nice{};
+    std::string io_priority_class;  // realtime, best-effort or idle; empty leaves it unchanged
+    unsigned int io_priority_level{4};
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ResourceConfig, threads, cpu_affinity, memory_limit_mb, nice,
+                                                io_priority_class, io_priority_level)
+};
+
+struct AllowlistConfig {
+    std::vector<std::string> exact, suffix, patterns;
+    bool honor_source_exceptions{true};
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(AllowlistConfig, exact, suffix, patterns, honor_source_exceptions)
+};
+
+struct SourceReportConfig {
+    bool enabled{true};
+    std::string file;  // JSON copy of the report with the full overlap matrix, empty only prints it
+    double min_jaccard{0.25};  // source pairs overlapping at least this much are printed
+    size_t max_overlaps{5};  // most similar sources kept per source
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(SourceReportConfig, enabled, file, min_jaccard, max_overlaps)
+};
+
+struct DNSClientPolicy {
+    std::string subnet;
+    unsigned int security_level{};
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(DNSClientPolicy, subnet, security_level)
+};
+
+struct DNSServerConfig {
+    bool enabled{};
+    std::string listen_address{"0.0.0.0"}, upstream{"1.1.1.1"}, block_mode{"nxdomain"};
+    unsigned int port{53}, upstream_port{53}, upstream_timeout_ms{2000}, ttl{300};
+    unsigned int default_security_level{}, refresh_interval_hours{24};
+    std::vector<DNSClientPolicy> clients;
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(DNSServerConfig, enabled, listen_address, upstream, block_mode, port,
+                                                upstream_port, upstream_timeout_ms, ttl, default_security_level,
+                                                refresh_interval_hours, clients)
+};
+
+struct GatewayConfig {
+    std::string name;
+    FortiGateConfig fortigate;
+    std::vector<FortiHoleConfig> forti_hole_automated_dns_filters;
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(GatewayConfig, name, fortigate, forti_hole_automated_dns_filters)
+};
+
 struct Config {
     FortiGateConfig fortigate;
     std::string output_dir;
@@ -94,14 +167,34 @@ struct Config {
     bool write_files_to_disk{}, remove_all_threat_feeds_on_run{};
     Categories categories;
     std::vector<FortiHoleConfig> forti_hole_automated_dns_filters;
+    std::vector<GatewayConfig> gateways;
+    unsigned int gateway_concurrency{};
+    JournalConfig journal;
+    ResourceConfig resources;
+    AllowlistConfig allowlist;
+    SourceReportConfig source_report;
+    DNSServerConfig dns_server;
+    std::string trace_file;  // Chrome/Perfetto timeline of the run, empty disables tracing
     std::vector<Blocklist> blocklist_sources;
 
     Config() = default;
-    explicit Config(const YAML::Node& node) { *this = yamlToJson(node); }
+    explicit Config(const YAML::Node& node) {
+        *this = yamlToJson(node);
+
+        // single-firewall configs keep the top-level fortigate block, treat it as the only gateway
+        // (DNS-server-only setups may leave it out entirely)
+        if (gateways.empty() && !fortigate.gateway_ip.empty())
+            gateways.push_back({fortigate.gateway_ip, fortigate, forti_hole_automated_dns_filters});
+
+        for (auto& gateway : gateways) if (gateway.name.empty()) gateway.name = gateway.fortigate.gateway_ip;
+        if (gateway_concurrency == 0) gateway_concurrency = gateways.size();
+    }
 
     NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Config, fortigate, output_dir, naming_convention, write_files_to_disk,
                                                 remove_all_threat_feeds_on_run, categories,
-                                                forti_hole_automated_dns_filters, blocklist_sources)
+                                                forti_hole_automated_dns_filters, gateways, gateway_concurrency,
+                                                journal, resources, allowlist, source_report, dns_server, trace_file,
+                                                blocklist_sources)
 };
 
 
@@ -15,6 +15,9 @@
 #include <utility>
 #include <future>
 #include "ThreadPool.h"
+#include "Journal.h"
+#include "DomainIndex.h"
+#include "ResourceGovernor.h"
 #include <memory>
 
 class FortiHole {
@@ -25,40 +28,67 @@ class FortiHole {
 
     static constexpr unsigned int MAX_LINES_PER_FILE = 131000;
 
+    ResourceOverrides overrides;
     Config config;
+    uint64_t config_hash{};
+    Journal journal{};
     std::vector<FortiHoleRequest> requests{};
     std::shared_ptr<std::vector<std::unordered_set<std::string>>> lists_by_security_level{};
-    std::vector<ThreatFeedInfo> info_by_security_level{};
+    ThreatFeedBuild build{};
     std::vector<std::future<ExpectedFuture>> futures{};
-    ThreadPool threadPool{};
+    ThreadPool threadPool;
     unsigned int total_num_files{};
     std::shared_ptr<std::vector<std::mutex>> locks{};
+    std::shared_ptr<const Allowlist> allowlist{};
+    std::shared_ptr<SourceExceptions> source_exceptions{};
+    std::vector<std::shared_ptr<SourceSketch>> source_sketches{};  // parallel to requests
+
+    static Config load_config(const std::string& config_file, const ResourceOverrides& overrides);
 
     // scraping
     void process_config();
     void fetch_multi();
     void process_multi();
+    void apply_source_exceptions();
+    void report_sources() const;
 
     // forti-hole
     void build_threat_feed_info();
-    void create_threat_feeds();
-    void enable_filters_and_policies();
-    void update_threat_feeds();
-    void build_threat_feed_futures(unsigned int security_level);
-    void process_threat_feed_futures(unsigned int security_level);
+    void build_threat_feed_parts();
+    void push_to_gateways();
+
+    // journal
+    [[nodiscard]] bool resume_from_journal();
+    void start_journal();
+    void save_build_to_journal();
+    void finish_journal();
+    [[nodiscard]] std::filesystem::path gateway_journal_path(const GatewayConfig& gateway) const;
+    [[nodiscard]] bool push_to_gateways_in_process();
+    [[nodiscard]] bool push_to_gateways_forked();
 
     void create_file(const std::string& filename, const std::vector<std::string>& lines) const;
-    void remove_extra_files(unsigned int security_level, unsigned int file_index);
-
-    std::string get_file_name(unsigned int security_level, unsigned int file_index);
-
-    static void remove_all_custom_threat_feeds();
 
 public:
 
-    explicit FortiHole(const std::string& config_file = "config.yaml");
+    explicit FortiHole(const std::string& config_file = "config.yaml", const ResourceOverrides& overrides = {});
 
+    // build_lists() then push()
     void operator()();
+
+    // fetches and parses every source into threat feed parts, or picks an interrupted run back up from its journal
+    void build_lists();
+    void push();
+
+    [[nodiscard]] std::shared_ptr<const DomainIndex> domain_index() const;
+
+    // the config allowlist plus the sources' '@@' rules, for names the index blocks through a parent domain
+    [[nodiscard]] std::shared_ptr<const Allowlist> dns_allowlist() const;
+    [[nodiscard]] bool serves_dns() const { return config.dns_server.enabled; }
+
+    // Builds the lists and serves DNS from them before pushing to the gateways, so a failed push never delays or
+    // stops DNS. Re-runs the pipeline every dns_server.refresh_interval_hours, swapping the new index in as soon as
+    // it is built. Blocks for the life of the process.
+    void serve_dns(const std::string& config_file);
 };
 
 
@@ -0,0 +1,32 @@
+#ifndef FORTI_HOLE_HASH_H
+#define FORTI_HOLE_HASH_H
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Stable across runs and platforms (unlike std::hash), so it is safe to persist.
+inline static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+inline static constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+inline constexpr uint64_t fnv1a_64(std::string_view data, uint64_t hash = FNV_OFFSET_BASIS) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// name reduced to [A-Za-z0-9.-] for use in a filename, plus a hash of the original so distinct names never collide
+inline std::string file_safe_name(std::string_view name) {
+    std::string safe;
+    for (unsigned char c : name) safe += std::isalnum(c) || c == '-' || c == '.' ? static_cast<char>(c) : '_';
+
+    safe += '-';
+    auto hash = fnv1a_64(name);
+    for (int shift = 60; shift >= 0; shift -= 4) safe += "0123456789abcdef"[hash >> shift & 0xf];
+    return safe;
+}
+
+#endif //FORTI_HOLE_HASH_H
@@ -1,9 +1,61 @@
 #include "include/forti_hole.h"
+#include "include/Tracer.h"
+#include <iostream>
+#include <string>
 
 
-int main() {
-    FortiHole fortiHole;
-    fortiHole();
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --config <file>           config file (default: config.yaml)\n"
+              << "  --threads <n>             worker threads (default: from cgroup CPU quota and affinity)\n"
+              << "  --cpus <list>             pin to CPUs, e.g. 0,2-3\n"
+              << "  --memory-limit-mb <mb>    cap the process data segment\n"
+              << "  --nice <n>                scheduling niceness\n"
+              << "  --io-class <class>        realtime, best-effort or idle\n"
+              << "  --io-level <0-7>          priority within the io class\n"
+              << "  --trace <file>            write a Chrome/Perfetto timeline of the run to file\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string config_file = "config.yaml";
+    ResourceOverrides overrides;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage(argv[0]);
+                return 0;
+            }
+            if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+            std::string value = argv[++i];
+
+            if (arg == "--config") config_file = value;
+            else if (arg == "--threads") overrides.threads = ResourceGovernor::parse_unsigned(value);
+            else if (arg == "--cpus") overrides.cpu_affinity = ResourceGovernor::parse_cpu_list(value);
+            else if (arg == "--memory-limit-mb") overrides.memory_limit_mb = ResourceGovernor::parse_unsigned(value);
+            else if (arg == "--nice") overrides.nice = std::stoi(value);
+            else if (arg == "--io-class") overrides.io_priority_class = value;
+            else if (arg == "--io-level") overrides.io_priority_level = ResourceGovernor::parse_unsigned(value);
+            else if (arg == "--trace") Tracer::enable(value);
+            else throw std::invalid_argument("Unknown option " + arg);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        usage(argv[0]);
+        return 1;
+    }
+
+    Tracer::set_thread_name("main");
+    FortiHole fortiHole(config_file, overrides);
+    try {
+        if (fortiHole.serves_dns()) fortiHole.serve_dns(config_file);
+        else fortiHole();
+    } catch (...) {
+        Tracer::flush();  // a failed run is the one worth looking at
+        throw;
+    }
+    Tracer::flush();
 
     return 0;
 }
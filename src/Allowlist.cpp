@@ -0,0 +1,67 @@
+#include "include/Allowlist.h"
+#include <algorithm>
+#include <cctype>
+
+static std::string to_lower(std::string_view value) {
+    std::string lowered(value);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lowered;
+}
+
+Allowlist::Allowlist(const AllowlistConfig& config) :
+        exact(config.exact.size()), suffix(config.suffix.size()) {
+    for (const auto& domain : config.exact) exact.insert(domain);
+    for (const auto& domain : config.suffix) suffix.insert(domain);
+
+    std::string combined;
+    for (const auto& pattern : config.patterns) {
+        if (pattern.size() >= 2 && pattern.front() == '/' && pattern.back() == '/') {
+            if (!combined.empty()) combined += '|';
+            combined += "(?:" + pattern.substr(1, pattern.size() - 2) + ")";
+            continue;
+        }
+
+        auto lowered = to_lower(pattern);
+        auto wildcard = lowered.find_last_of("*?");
+        if (wildcard == std::string::npos) exact.insert(lowered);
+        else globs.push_back({lowered, lowered.substr(wildcard + 1)});
+    }
+
+    if (!combined.empty())
+        regex.emplace(combined, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+}
+
+bool Allowlist::glob_match(std::string_view pattern, std::string_view domain) {
+    size_t p = 0, d = 0, star = std::string_view::npos, resume = 0;
+    while (d < domain.size()) {
+        auto c = static_cast<char>(std::tolower(static_cast<unsigned char>(domain[d])));
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == c)) {
+            ++p;
+            ++d;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = d;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            d = ++resume;
+        } else return false;
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+bool Allowlist::allows(std::string_view domain) const {
+    if (exact.contains(domain) || suffix.lookup(domain) != DomainIndex::NOT_BLOCKED) return true;
+
+    for (const auto& glob : globs) {
+        if (domain.size() < glob.tail.size()) continue;
+        auto tail = domain.substr(domain.size() - glob.tail.size());
+        if (!std::equal(tail.begin(), tail.end(), glob.tail.begin(), glob.tail.end(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == b;
+        })) continue;
+        if (glob_match(glob.pattern, domain)) return true;
+    }
+
+    return regex && std::regex_match(domain.begin(), domain.end(), *regex);
+}
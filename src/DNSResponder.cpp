@@ -0,0 +1,597 @@
+#include "include/DNSResponder.h"
+
+#ifdef __linux__
+
+#include "include/hash.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint64_t UDP_TAG = 1, TCP_TAG = 2, UPSTREAM_TAG = 3, STOP_TAG = 4, FIRST_CONNECTION = 16;
+
+    constexpr size_t HEADER_SIZE = 12;
+    constexpr uint16_t TYPE_A = 1, TYPE_AAAA = 28, CLASS_IN = 1;
+    constexpr uint8_t FLAG_TC = 0x02, RCODE_NXDOMAIN = 3;
+
+    inline uint16_t read_u16(const uint8_t* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+    inline void write_u16(uint8_t* p, uint16_t value) {
+        p[0] = static_cast<uint8_t>(value >> 8);
+        p[1] = static_cast<uint8_t>(value);
+    }
+
+    inline void write_u32(uint8_t* p, uint32_t value) {
+        write_u16(p, static_cast<uint16_t>(value >> 16));
+        write_u16(p + 2, static_cast<uint16_t>(value));
+    }
+
+    // Decodes the single question of a standard query into dotted form. Returns the offset past the question,
+    // or 0 if the message is not something we answer locally.
+    size_t parse_question(const uint8_t* message, size_t length, char* qname, size_t& qname_length, uint16_t& qtype) {
+        if (length < HEADER_SIZE) return 0;
+        if (message[2] & 0x80 || (message[2] & 0x78) != 0) return 0;  // response, or opcode other than QUERY
+        if (read_u16(message + 4) != 1) return 0;
+
+        size_t pos = HEADER_SIZE;
+        qname_length = 0;
+        while (true) {
+            if (pos >= length) return 0;
+            uint8_t label = message[pos++];
+            if (label == 0) break;
+            if (label & 0xC0 || pos + label > length || qname_length + label + 1 > 255) return 0;
+            if (qname_length) qname[qname_length++] = '.';
+            std::memcpy(qname + qname_length, message + pos, label);
+            qname_length += label;
+            pos += label;
+        }
+
+        if (pos + 4 > length || read_u16(message + pos + 2) != CLASS_IN) return 0;
+        qtype = read_u16(message + pos);
+        return pos + 4;
+    }
+
+    // Case-insensitive hash of the question section (qdcount and every question), or 0 if it does not parse.
+    // end, if given, receives the offset past the question section.
+    uint64_t question_hash(const uint8_t* message, size_t length, size_t* end = nullptr) {
+        if (length < HEADER_SIZE) return 0;
+        uint64_t hash = FNV_OFFSET_BASIS;
+        auto mix = [&hash](uint8_t byte) {
+            hash ^= byte;
+            hash *= FNV_PRIME;
+        };
+        mix(message[4]);
+        mix(message[5]);
+
+        size_t pos = HEADER_SIZE;
+        for (uint16_t question = read_u16(message + 4); question > 0; --question) {
+            while (true) {
+                if (pos >= length) return 0;
+                uint8_t label = message[pos++];
+                mix(label);
+                if (label == 0) break;
+                if (label & 0xC0 || pos + label > length) return 0;
+                for (size_t end = pos + label; pos < end; ++pos)
+                    mix(static_cast<uint8_t>(std::tolower(message[pos])));
+            }
+            if (pos + 4 > length) return 0;
+            for (size_t type_end = pos + 4; pos < type_end; ++pos) mix(message[pos]);
+        }
+        if (end) *end = pos;
+        return hash;
+    }
+
+    int make_socket(int type) {
+        int fd = ::socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error(std::string("socket() failed: ") + std::strerror(errno));
+        return fd;
+    }
+
+    sockaddr_in make_address(const std::string& ip, unsigned int port) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (inet_pton(AF_INET, ip.c_str(), &address.sin_addr) != 1)
+            throw std::runtime_error("Not a valid IPv4 address: " + ip);
+        return address;
+    }
+}
+
+DNSResponder::DNSResponder(const DNSServerConfig& config, std::shared_ptr<const DomainIndex> index,
+                           std::shared_ptr<const Allowlist> allowlist) :
+        config(config), lists(std::make_shared<const Lists>(std::move(index), std::move(allowlist))),
+        null_mode(config.block_mode == "null"),
+        pending(UINT16_MAX + 1), next_connection(FIRST_CONNECTION),
+        inbound(std::make_unique<Batch>()), replies(std::make_unique<Batch>()), relays(std::make_unique<Batch>()) {
+    if (!null_mode && config.block_mode != "nxdomain")
+        throw std::runtime_error("Not a valid dns_server.block_mode: " + config.block_mode);
+
+    for (const auto& client : config.clients) {
+        auto slash = client.subnet.find('/');
+        unsigned int prefix = slash == std::string::npos ? 32 : std::stoul(client.subnet.substr(slash + 1));
+        if (prefix > 32) throw std::runtime_error("Not a valid IPv4 subnet: " + client.subnet);
+
+        uint32_t mask = prefix == 0 ? 0 : ~uint32_t{0} << (32 - prefix);
+        auto address = make_address(client.subnet.substr(0, slash), 0);
+        clients.push_back({ntohl(address.sin_addr.s_addr) & mask, mask, client.security_level});
+    }
+
+    // most specific subnet wins
+    std::stable_sort(clients.begin(), clients.end(), [](const auto& a, const auto& b) { return a.mask > b.mask; });
+
+    try { open_sockets(); }
+    catch (...) {
+        close_sockets();
+        throw;
+    }
+}
+
+DNSResponder::~DNSResponder() { close_sockets(); }
+
+void DNSResponder::open_sockets() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || stop_fd < 0) throw std::runtime_error(std::string("epoll setup failed: ") + std::strerror(errno));
+
+    auto listen_address = make_address(config.listen_address, config.port);
+    int one = 1, buffer_size = 4 << 20;
+
+    udp_fd = make_socket(SOCK_DGRAM);
+    setsockopt(udp_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    if (bind(udp_fd, reinterpret_cast<sockaddr*>(&listen_address), sizeof(listen_address)) != 0)
+        throw std::runtime_error("Failed to bind DNS UDP socket: " + std::string(std::strerror(errno)));
+
+    // port 0 binds an ephemeral UDP port, TCP follows it
+    socklen_t address_length = sizeof(listen_address);
+    getsockname(udp_fd, reinterpret_cast<sockaddr*>(&listen_address), &address_length);
+    bound_port = ntohs(listen_address.sin_port);
+
+    tcp_fd = make_socket(SOCK_STREAM);
+    setsockopt(tcp_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(tcp_fd, reinterpret_cast<sockaddr*>(&listen_address), sizeof(listen_address)) != 0 ||
+        listen(tcp_fd, SOMAXCONN) != 0)
+        throw std::runtime_error("Failed to bind DNS TCP socket: " + std::string(std::strerror(errno)));
+
+    upstream_address = make_address(config.upstream, config.upstream_port);
+    upstream_fd = make_socket(SOCK_DGRAM);
+    setsockopt(upstream_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    if (connect(upstream_fd, reinterpret_cast<sockaddr*>(&upstream_address), sizeof(upstream_address)) != 0)
+        throw std::runtime_error("Failed to connect to upstream DNS: " + std::string(std::strerror(errno)));
+
+    for (auto [fd, tag] : {std::pair{udp_fd, UDP_TAG}, {tcp_fd, TCP_TAG}, {upstream_fd, UPSTREAM_TAG}, {stop_fd, STOP_TAG}}) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = tag;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+            throw std::runtime_error(std::string("epoll_ctl() failed: ") + std::strerror(errno));
+    }
+}
+
+void DNSResponder::close_sockets() {
+    for (auto& [id, connection] : tcp_connections) ::close(connection.fd);
+    tcp_connections.clear();
+    for (int* fd : {&udp_fd, &tcp_fd, &upstream_fd, &stop_fd, &epoll_fd}) {
+        if (*fd >= 0) ::close(*fd);
+        *fd = -1;
+    }
+}
+
+void DNSResponder::set_index(std::shared_ptr<const DomainIndex> next, std::shared_ptr<const Allowlist> allowlist) {
+    lists.store(std::make_shared<const Lists>(std::move(next), std::move(allowlist)));
+}
+
+void DNSResponder::stop() {
+    uint64_t value = 1;
+    [[maybe_unused]] auto n = ::write(stop_fd, &value, sizeof(value));
+}
+
+DNSResponder::Stats DNSResponder::stats() const {
+    return {queries.load(std::memory_order_relaxed), blocked.load(std::memory_order_relaxed),
+            forwarded.load(std::memory_order_relaxed), dropped.load(std::memory_order_relaxed)};
+}
+
+void DNSResponder::serve() {
+    std::array<epoll_event, BATCH_SIZE> events{};
+
+    while (true) {
+        int n = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 250);
+        if (n < 0 && errno != EINTR) throw std::runtime_error(std::string("epoll_wait() failed: ") + std::strerror(errno));
+
+        for (int i = 0; i < n; ++i) {
+            auto tag = events[i].data.u64;
+            if (tag == STOP_TAG) return;
+            else if (tag == UDP_TAG) drain_udp();
+            else if (tag == UPSTREAM_TAG) drain_upstream();
+            else if (tag == TCP_TAG) accept_tcp();
+            else if (events[i].events & (EPOLLHUP | EPOLLERR)) close_tcp(tag);
+            else {
+                if (events[i].events & EPOLLOUT) flush_tcp(tag);
+                if (events[i].events & EPOLLIN) read_tcp(tag);
+            }
+        }
+
+        expire_pending();
+    }
+}
+
+unsigned int DNSResponder::security_level_for(uint32_t client_ip) const {
+    for (const auto& range : clients) if ((client_ip & range.mask) == range.network) return range.security_level;
+    return config.default_security_level;
+}
+
+DNSResponder::Action DNSResponder::handle_query(const Lists& domains, const uint8_t* query, size_t length,
+                                                uint32_t client_ip, uint8_t* reply, size_t& reply_length) {
+    queries.fetch_add(1, std::memory_order_relaxed);
+
+    char qname[256];
+    size_t qname_length = 0;
+    uint16_t qtype = 0;
+    size_t question_end = parse_question(query, length, qname, qname_length, qtype);
+    if (question_end == 0) return length >= HEADER_SIZE && !(query[2] & 0x80) ? Action::Forward : Action::Drop;
+
+    std::string_view name(qname, qname_length);
+    if (!domains.index->blocks(name, security_level_for(client_ip))) return Action::Forward;
+    if (domains.allowlist && domains.allowlist->allows(name)) return Action::Forward;  // only blocked names pay for it
+
+    blocked.fetch_add(1, std::memory_order_relaxed);
+
+    // echo the header and question, drop any EDNS/additional records
+    std::memcpy(reply, query, question_end);
+    reply[2] = static_cast<uint8_t>(0x80 | (query[2] & 0x01));  // QR, keep RD
+    reply[3] = static_cast<uint8_t>(0x80 | (null_mode ? 0 : RCODE_NXDOMAIN));  // RA
+    write_u16(reply + 6, 0);
+    write_u16(reply + 8, 0);
+    write_u16(reply + 10, 0);
+    reply_length = question_end;
+
+    if (null_mode && (qtype == TYPE_A || qtype == TYPE_AAAA)) {
+        uint16_t rdlength = qtype == TYPE_A ? 4 : 16;
+        uint8_t* answer = reply + reply_length;
+        write_u16(answer, static_cast<uint16_t>(0xC000 | HEADER_SIZE));  // pointer to the question name
+        write_u16(answer + 2, qtype);
+        write_u16(answer + 4, CLASS_IN);
+        write_u32(answer + 6, config.ttl);
+        write_u16(answer + 10, rdlength);
+        std::memset(answer + 12, 0, rdlength);
+        reply_length += 12 + rdlength;
+        write_u16(reply + 6, 1);
+    }
+
+    return Action::Reply;
+}
+
+// IDs come from the kernel CSPRNG so an off-path sender cannot predict which ID the next relay uses.
+uint16_t DNSResponder::random_id() {
+    if (random_ids_left == 0) {
+        auto bytes = sizeof(random_ids);
+        if (getrandom(random_ids.data(), bytes, 0) != static_cast<ssize_t>(bytes))
+            throw std::runtime_error(std::string("getrandom() failed: ") + std::strerror(errno));
+        random_ids_left = random_ids.size();
+    }
+    return random_ids[--random_ids_left];
+}
+
+bool DNSResponder::register_pending(uint8_t* query, size_t length, const sockaddr_in& client) {
+    if (pending_count > UINT16_MAX) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // probe onward from a random slot, a free one is always found since the table is not full
+    uint16_t id = random_id();
+    while (pending[id].active) ++id;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.upstream_timeout_ms);
+    pending[id] = {client, deadline, question_hash(query, length), read_u16(query), true};
+    pending_order.emplace_back(deadline, id);
+    ++pending_count;
+
+    write_u16(query, id);
+    forwarded.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Unanswered relays are dropped; clients retry on their own schedule like they would against any resolver.
+void DNSResponder::expire_pending() {
+    auto now = std::chrono::steady_clock::now();
+    while (!pending_order.empty() && pending_order.front().first <= now) {
+        auto [deadline, id] = pending_order.front();
+        pending_order.pop_front();
+        if (!pending[id].active || pending[id].deadline != deadline) continue;
+        pending[id].active = false;
+        --pending_count;
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void DNSResponder::drain_udp() {
+    auto domains = lists.load(std::memory_order_acquire);
+    auto& in = *inbound;
+
+    while (true) {
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            in.iovecs[i] = {in.buffers[i].data(), MAX_UDP_MESSAGE};
+            in.headers[i].msg_hdr = {};
+            in.headers[i].msg_hdr.msg_name = &in.addresses[i];
+            in.headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            in.headers[i].msg_hdr.msg_iov = &in.iovecs[i];
+            in.headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int received = recvmmsg(udp_fd, in.headers.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received <= 0) return;
+
+        unsigned int reply_count = 0, relay_count = 0;
+        for (int i = 0; i < received; ++i) {
+            auto* query = in.buffers[i].data();
+            size_t length = in.headers[i].msg_len;
+            auto& client = in.addresses[i];
+            if (in.headers[i].msg_hdr.msg_flags & MSG_TRUNC) {  // no DNS query is this large
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            size_t reply_length = 0;
+            auto action = handle_query(*domains, query, length, ntohl(client.sin_addr.s_addr),
+                                       replies->buffers[reply_count].data(), reply_length);
+
+            if (action == Action::Reply) {
+                replies->iovecs[reply_count] = {replies->buffers[reply_count].data(), reply_length};
+                auto& header = replies->headers[reply_count].msg_hdr;
+                header = {};
+                replies->addresses[reply_count] = client;
+                header.msg_name = &replies->addresses[reply_count];
+                header.msg_namelen = sizeof(sockaddr_in);
+                header.msg_iov = &replies->iovecs[reply_count];
+                header.msg_iovlen = 1;
+                ++reply_count;
+            } else if (action == Action::Forward && register_pending(query, length, client)) {
+                relays->iovecs[relay_count] = {query, length};
+                relays->headers[relay_count].msg_hdr = {};
+                relays->headers[relay_count].msg_hdr.msg_iov = &relays->iovecs[relay_count];
+                relays->headers[relay_count].msg_hdr.msg_iovlen = 1;
+                ++relay_count;
+            }
+        }
+
+        send_batch(udp_fd, *replies, reply_count);
+        send_batch(upstream_fd, *relays, relay_count);
+
+        if (static_cast<size_t>(received) < BATCH_SIZE) return;
+    }
+}
+
+void DNSResponder::drain_upstream() {
+    auto& in = *relays;
+
+    while (true) {
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            in.iovecs[i] = {in.buffers[i].data(), MAX_UDP_MESSAGE};
+            in.headers[i].msg_hdr = {};
+            in.headers[i].msg_hdr.msg_iov = &in.iovecs[i];
+            in.headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int received = recvmmsg(upstream_fd, in.headers.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received <= 0) return;
+
+        unsigned int reply_count = 0;
+        for (int i = 0; i < received; ++i) {
+            auto* response = in.buffers[i].data();
+            size_t length = in.headers[i].msg_len;
+            if (length < HEADER_SIZE) continue;
+
+            // a stray or forged answer must carry both a live ID and the question that was asked
+            auto& entry = pending[read_u16(response)];
+            size_t question_end = 0;
+            if (!entry.active || question_hash(response, length, &question_end) != entry.question) continue;
+            entry.active = false;
+            --pending_count;
+            write_u16(response, entry.client_id);
+
+            // larger than the client asked for and than we can receive, relaying the cut off datagram would hand
+            // the client a corrupt answer; tell it to retry over TCP instead
+            if (in.headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                response[2] |= FLAG_TC;
+                write_u16(response + 6, 0);
+                write_u16(response + 8, 0);
+                write_u16(response + 10, 0);
+                length = question_end;
+            }
+
+            replies->iovecs[reply_count] = {response, length};
+            auto& header = replies->headers[reply_count].msg_hdr;
+            header = {};
+            replies->addresses[reply_count] = entry.client;
+            header.msg_name = &replies->addresses[reply_count];
+            header.msg_namelen = sizeof(sockaddr_in);
+            header.msg_iov = &replies->iovecs[reply_count];
+            header.msg_iovlen = 1;
+            ++reply_count;
+        }
+
+        send_batch(udp_fd, *replies, reply_count);
+
+        if (static_cast<size_t>(received) < BATCH_SIZE) return;
+    }
+}
+
+// sendmmsg stops at the first message that fails, so resume after it; failed datagrams count as dropped.
+void DNSResponder::send_batch(int fd, Batch& batch, unsigned int count) {
+    unsigned int sent = 0;
+    while (sent < count) {
+        int n = sendmmsg(fd, batch.headers.data() + sent, count - sent, 0);
+        if (n > 0) sent += static_cast<unsigned int>(n);
+        else if (n < 0 && errno == EINTR) continue;
+        else {
+            ++sent;
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void DNSResponder::accept_tcp() {
+    while (true) {
+        sockaddr_in client{};
+        socklen_t length = sizeof(client);
+        int fd = accept4(tcp_fd, reinterpret_cast<sockaddr*>(&client), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        if (tcp_connections.size() >= MAX_TCP_CONNECTIONS) {
+            ::close(fd);
+            continue;
+        }
+        add_tcp(fd, false);
+    }
+}
+
+// Registers fd with the loop and returns its connection id, or 0 (with fd closed) on failure.
+uint64_t DNSResponder::add_tcp(int fd, bool upstream) {
+    uint64_t id = next_connection++;
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        ::close(fd);
+        return 0;
+    }
+    tcp_connections.emplace(id, TcpConnection{fd, {}, {}, 0, upstream});
+    return id;
+}
+
+// Clients send queries, upstream connections send the answers to relay back to their client. Either may close
+// right after its last message, so complete messages are handled before the connection is.
+void DNSResponder::read_tcp(uint64_t connection) {
+    auto it = tcp_connections.find(connection);
+    if (it == tcp_connections.end()) return;
+    auto* tcp = &it->second;
+
+    char chunk[4096];
+    bool closed = false;
+    while (true) {
+        auto n = ::read(tcp->fd, chunk, sizeof(chunk));
+        if (n > 0) tcp->in.append(chunk, static_cast<size_t>(n));
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        else if (n < 0 && errno == EINTR) continue;
+        else {
+            closed = true;
+            break;
+        }
+        if (tcp->in.size() > MAX_TCP_BUFFER) return close_tcp(connection);
+    }
+
+    sockaddr_in client{};
+    socklen_t length = sizeof(client);
+    getpeername(tcp->fd, reinterpret_cast<sockaddr*>(&client), &length);
+
+    auto domains = lists.load(std::memory_order_acquire);
+    size_t consumed = 0;
+    while (tcp->in.size() - consumed >= 2) {
+        auto* frame = reinterpret_cast<uint8_t*>(tcp->in.data() + consumed);
+        size_t message_length = read_u16(frame);
+        if (tcp->in.size() - consumed < message_length + 2) break;
+        uint8_t* message = frame + 2;
+        consumed += message_length + 2;
+
+        if (tcp->upstream) send_tcp(tcp->peer, message, message_length);
+        else {
+            uint8_t reply[MAX_REPLY];
+            size_t reply_length = 0;
+            auto action = handle_query(*domains, message, message_length, ntohl(client.sin_addr.s_addr), reply,
+                                       reply_length);
+            if (action == Action::Reply) send_tcp(connection, reply, reply_length);
+            else if (action == Action::Forward) forward_tcp(connection, message, message_length);
+        }
+
+        if (!tcp_connections.contains(connection)) return;  // closed by a failed write
+    }
+
+    tcp->in.erase(0, consumed);
+    if (closed) close_tcp(connection);
+}
+
+// Relays over the client's own upstream connection, opened on its first forwarded query. Answers come back in
+// full and in upstream order, so they need neither the pending table nor a new ID.
+void DNSResponder::forward_tcp(uint64_t connection, const uint8_t* query, size_t length) {
+    auto& client = tcp_connections.at(connection);
+
+    if (!client.peer) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&upstream_address), sizeof(upstream_address)) != 0
+            && errno != EINPROGRESS) {
+            ::close(fd);
+            fd = -1;
+        }
+
+        uint64_t peer = fd < 0 ? 0 : add_tcp(fd, true);
+        if (!peer) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return close_tcp(connection);
+        }
+        client.peer = peer;
+        tcp_connections.at(peer).peer = connection;
+    }
+
+    forwarded.fetch_add(1, std::memory_order_relaxed);
+    send_tcp(client.peer, query, length);  // queued until the connect completes, a failed one detaches
+}
+
+void DNSResponder::send_tcp(uint64_t connection, const uint8_t* message, size_t length) {
+    auto it = tcp_connections.find(connection);
+    if (it == tcp_connections.end()) return;
+
+    uint8_t prefix[2];
+    write_u16(prefix, static_cast<uint16_t>(length));
+    it->second.out.append(reinterpret_cast<char*>(prefix), 2);
+    it->second.out.append(reinterpret_cast<const char*>(message), length);
+    flush_tcp(connection);
+}
+
+void DNSResponder::flush_tcp(uint64_t connection) {
+    auto it = tcp_connections.find(connection);
+    if (it == tcp_connections.end()) return;
+    auto& [fd, in, out, peer, upstream] = it->second;
+
+    size_t sent = 0;
+    while (sent < out.size()) {
+        auto n = ::send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) sent += static_cast<size_t>(n);
+        else if (n < 0 && errno == EINTR) continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        else return close_tcp(connection);
+    }
+    out.erase(0, sent);
+    if (out.size() > MAX_TCP_BUFFER) return close_tcp(connection);
+
+    epoll_event event{};
+    event.events = out.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+    event.data.u64 = connection;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+// A closed client takes its upstream connection with it. A closed upstream connection (e.g. the resolver's idle
+// timeout) only detaches, the client's next forwarded query opens a new one.
+void DNSResponder::close_tcp(uint64_t connection) {
+    auto it = tcp_connections.find(connection);
+    if (it == tcp_connections.end()) return;
+    auto [peer, upstream] = std::pair{it->second.peer, it->second.upstream};
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    ::close(it->second.fd);
+    tcp_connections.erase(it);
+
+    if (!peer) return;
+    if (upstream) {
+        if (auto client = tcp_connections.find(peer); client != tcp_connections.end()) client->second.peer = 0;
+    } else close_tcp(peer);
+}
+
+#endif // __linux__
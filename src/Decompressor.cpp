@@ -0,0 +1,164 @@
+#include "include/Decompressor.h"
+#include <brotli/decode.h>
+#include <zlib.h>
+#include <zstd.h>
+#include <array>
+#include <cctype>
+#include <stdexcept>
+
+static constexpr size_t SCRATCH_SIZE = 1 << 16;
+
+static void free_gzip(z_stream_s* stream) {
+    inflateEnd(stream);
+    delete stream;
+}
+
+static void free_zstd(ZSTD_DCtx_s* context) { ZSTD_freeDCtx(context); }
+
+static void free_brotli(BrotliDecoderStateStruct* state) { BrotliDecoderDestroyInstance(state); }
+
+Decompressor::Decompressor(Format format) :
+        format(format), gzip(nullptr, free_gzip), zstd(nullptr, free_zstd), brotli(nullptr, free_brotli) {
+    if (format == Format::Gzip) {
+        auto stream = new z_stream{};
+        if (inflateInit2(stream, 15 + 32) != Z_OK) {  // +32: accept gzip or zlib headers
+            delete stream;
+            throw std::runtime_error("inflateInit2() failed");
+        }
+        gzip.reset(stream);
+    } else if (format == Format::Zstd) {
+        zstd.reset(ZSTD_createDCtx());
+        if (!zstd) throw std::runtime_error("ZSTD_createDCtx() failed");
+    } else if (format == Format::Brotli) {
+        brotli.reset(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr));
+        if (!brotli) throw std::runtime_error("BrotliDecoderCreateInstance() failed");
+    }
+}
+
+Decompressor::Format Decompressor::from_path(std::string_view path) {
+    if (auto query = path.find_first_of("?#"); query != std::string_view::npos) path = path.substr(0, query);
+    if (path.ends_with(".gz")) return Format::Gzip;
+    if (path.ends_with(".zst")) return Format::Zstd;
+    if (path.ends_with(".br")) return Format::Brotli;
+    return Format::None;
+}
+
+void Decompressor::declare_encoding(std::string_view content_encoding) {
+    std::string_view token;
+    switch (format) {
+        case Format::None: return;
+        case Format::Gzip: token = "gzip"; break;
+        case Format::Zstd: token = "zstd"; break;
+        case Format::Brotli: token = "br"; break;
+    }
+
+    // a comma separated list of codings, in the order they were applied
+    while (!content_encoding.empty()) {
+        auto comma = content_encoding.find(',');
+        auto coding = content_encoding.substr(0, comma);
+        content_encoding = comma == std::string_view::npos ? std::string_view{} : content_encoding.substr(comma + 1);
+
+        std::string name;
+        for (unsigned char c : coding)
+            if (!std::isspace(c)) name += static_cast<char>(std::tolower(c));
+        if (name == token || (format == Format::Gzip && name == "x-gzip")) {
+            format = Format::None;
+            return;
+        }
+    }
+}
+
+void Decompressor::feed(const char* data, size_t length, std::string& out) {
+    auto bytes = reinterpret_cast<const unsigned char*>(data);
+
+    // backs up declare_encoding() for servers that drop the header, only possible for formats with magic bytes;
+    // the first bytes are held back until there are enough of them to compare
+    if (!sniffed && length > 0) {
+        constexpr std::string_view gzip_magic = "\x1f\x8b", zstd_magic = "\x28\xb5\x2f\xfd";
+        auto magic = format == Format::Gzip ? gzip_magic : format == Format::Zstd ? zstd_magic : std::string_view{};
+
+        prefix.append(data, length);
+        if (prefix.size() < magic.size()) return;
+        sniffed = true;
+        if (!prefix.starts_with(magic)) format = Format::None;
+
+        auto held = std::move(prefix);
+        prefix.clear();
+        return feed(held.data(), held.size(), out);
+    }
+
+    switch (format) {
+        case Format::None: out.append(data, length); finished = true; break;
+        case Format::Gzip: feed_gzip(bytes, length, out); break;
+        case Format::Zstd: feed_zstd(bytes, length, out); break;
+        case Format::Brotli: feed_brotli(bytes, length, out); break;
+    }
+}
+
+void Decompressor::finish() const {
+    if (!prefix.empty() || (format != Format::None && sniffed && !finished))
+        throw std::runtime_error("Compressed stream is truncated");
+}
+
+void Decompressor::feed_gzip(const unsigned char* data, size_t length, std::string& out) {
+    std::array<unsigned char, SCRATCH_SIZE> scratch{};
+    auto stream = gzip.get();
+    stream->next_in = const_cast<unsigned char*>(data);
+    stream->avail_in = static_cast<uInt>(length);
+
+    while (true) {
+        stream->next_out = scratch.data();
+        stream->avail_out = scratch.size();
+
+        int result = inflate(stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+            throw std::runtime_error(std::string("gzip: ") + (stream->msg ? stream->msg : "corrupt stream"));
+
+        out.append(reinterpret_cast<char*>(scratch.data()), scratch.size() - stream->avail_out);
+
+        if (result == Z_STREAM_END) {
+            finished = true;
+            if (stream->avail_in == 0) return;
+            inflateReset(stream);  // concatenated members (pigz, appended updates) continue as a new stream
+            continue;
+        }
+
+        finished = false;
+        if (result == Z_BUF_ERROR || (stream->avail_in == 0 && stream->avail_out != 0)) return;
+    }
+}
+
+void Decompressor::feed_zstd(const unsigned char* data, size_t length, std::string& out) {
+    std::array<unsigned char, SCRATCH_SIZE> scratch{};
+    ZSTD_inBuffer input{data, length, 0};
+
+    ZSTD_outBuffer output{scratch.data(), scratch.size(), 0};
+    do {
+        output.pos = 0;
+        size_t result = ZSTD_decompressStream(zstd.get(), &output, &input);
+        if (ZSTD_isError(result)) throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(result));
+
+        out.append(reinterpret_cast<char*>(scratch.data()), output.pos);
+        finished = result == 0;
+    } while (input.pos < input.size || output.pos == output.size);
+}
+
+void Decompressor::feed_brotli(const unsigned char* data, size_t length, std::string& out) {
+    std::array<unsigned char, SCRATCH_SIZE> scratch{};
+    size_t available_in = length;
+    const uint8_t* next_in = data;
+
+    while (true) {
+        size_t available_out = scratch.size();
+        uint8_t* next_out = scratch.data();
+        auto result = BrotliDecoderDecompressStream(brotli.get(), &available_in, &next_in,
+                                                    &available_out, &next_out, nullptr);
+        if (result == BROTLI_DECODER_RESULT_ERROR)
+            throw std::runtime_error(std::string("brotli: ") +
+                                     BrotliDecoderErrorString(BrotliDecoderGetErrorCode(brotli.get())));
+
+        out.append(reinterpret_cast<char*>(scratch.data()), scratch.size() - available_out);
+        finished = result == BROTLI_DECODER_RESULT_SUCCESS;
+        if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) break;
+    }
+}
@@ -0,0 +1,130 @@
+#include "include/DomainIndex.h"
+#include "include/hash.h"
+#include "include/Task.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+static inline unsigned char to_lower(unsigned char c) { return (c >= 'A' && c <= 'Z') ? c | 0x20 : c; }
+
+// Hashes right to left so every label boundary yields the hash of that suffix for free.
+// The final mix spreads FNV's weak low bits before they are used as a table index.
+static inline uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static inline std::string_view strip_root(std::string_view domain) {
+    if (!domain.empty() && domain.back() == '.') domain.remove_suffix(1);
+    return domain;
+}
+
+static bool equals_ignore_case(std::string_view lowered, std::string_view other) {
+    if (lowered.size() != other.size()) return false;
+    for (size_t i = 0; i < other.size(); ++i)
+        if (lowered[i] != static_cast<char>(to_lower(other[i]))) return false;
+    return true;
+}
+
+DomainIndex::DomainIndex(const std::vector<std::unordered_set<std::string>>& lists_by_security_level) {
+    size_t total = 0;
+    for (const auto& list : lists_by_security_level) total += list.size();
+    reserve(total);
+
+    for (unsigned int security_level = 0; security_level < lists_by_security_level.size(); ++security_level)
+        for (const auto& domain : lists_by_security_level[security_level]) insert(domain, security_level);
+}
+
+DomainIndex::DomainIndex(const ThreatFeedBuild& build) {
+    size_t total = 0;
+    for (const auto& info : build.info_by_security_level) total += info.total_lines;
+    reserve(total);
+
+    for (unsigned int security_level = 0; security_level < build.parts_by_security_level.size(); ++security_level)
+        for (const auto& part : build.parts_by_security_level[security_level])
+            for (const auto& domain : part.lines) insert(domain, security_level);
+}
+
+void DomainIndex::reserve(size_t domains) {
+    // <= 70% load keeps linear probe chains short
+    size_t capacity = std::bit_ceil(std::max<size_t>(16, domains + domains / 2 + 1));
+    slots.assign(capacity, Slot{});
+    mask = capacity - 1;
+    arena.reserve(domains * 24);
+}
+
+void DomainIndex::grow() {
+    auto old = std::move(slots);
+    slots.assign(std::max<size_t>(16, old.size() * 2), Slot{});
+    mask = slots.size() - 1;
+
+    for (const auto& slot : old) {
+        if (!slot.used) continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].used) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+static inline uint64_t hash_reversed(std::string_view domain) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (auto it = domain.rbegin(); it != domain.rend(); ++it) hash = (hash ^ to_lower(*it)) * FNV_PRIME;
+    return mix(hash);
+}
+
+void DomainIndex::insert(std::string_view domain, unsigned int security_level) {
+    domain = strip_root(domain);
+    if (domain.empty() || domain.size() > UINT16_MAX) return;
+    if (security_level >= NOT_BLOCKED) throw std::out_of_range("DomainIndex supports at most 254 security levels");
+    if (arena.size() + domain.size() > UINT32_MAX) throw std::length_error("DomainIndex arena exceeds 4 GiB");
+    if ((count + 1) * 10 > slots.size() * 7) grow();
+
+    uint64_t hash = hash_reversed(domain);
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        auto& slot = slots[i];
+        if (!slot.used) {
+            slot = {hash, static_cast<uint32_t>(arena.size()), static_cast<uint16_t>(domain.size()),
+                    static_cast<uint8_t>(security_level), 1};
+            for (char c : domain) arena.push_back(static_cast<char>(to_lower(c)));
+            ++count;
+            return;
+        }
+        if (slot.hash == hash && equals_ignore_case({arena.data() + slot.offset, slot.length}, domain)) {
+            slot.security_level = std::min(slot.security_level, static_cast<uint8_t>(security_level));
+            return;
+        }
+    }
+}
+
+const DomainIndex::Slot* DomainIndex::find(uint64_t hash, std::string_view domain) const {
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const auto& slot = slots[i];
+        if (!slot.used) return nullptr;
+        if (slot.hash == hash && equals_ignore_case({arena.data() + slot.offset, slot.length}, domain)) return &slot;
+    }
+}
+
+bool DomainIndex::contains(std::string_view domain) const {
+    if (count == 0) return false;
+    domain = strip_root(domain);
+    return find(hash_reversed(domain), domain) != nullptr;
+}
+
+uint8_t DomainIndex::lookup(std::string_view qname) const {
+    if (count == 0) return NOT_BLOCKED;
+    qname = strip_root(qname);
+
+    uint8_t result = NOT_BLOCKED;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = qname.size(); i-- > 0;) {
+        hash = (hash ^ to_lower(qname[i])) * FNV_PRIME;
+        if (i != 0 && qname[i - 1] != '.') continue;
+
+        // qname[i..] is a whole-label suffix
+        if (auto slot = find(mix(hash), qname.substr(i))) result = std::min(result, slot->security_level);
+    }
+    return result;
+}
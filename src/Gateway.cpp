@@ -0,0 +1,198 @@
+#include "include/Gateway.h"
+#include "include/Tracer.h"
+#include <forti_api.hpp>
+#include <cassert>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <sys/wait.h>
+#include <unistd.h>
+
+Gateway::Gateway(const GatewayConfig& gateway, const Config& config, const ThreatFeedBuild& build,
+                 const std::filesystem::path& journal_path) :
+        gateway(gateway), config(config), build(build),
+        journal(journal_path.empty() ? Journal() : Journal(journal_path)) {}
+
+void Gateway::operator()() {
+    if (journal.has_phase("complete")) {
+        log() << "Already updated by the interrupted run, skipping" << std::endl;
+        return;
+    }
+
+    Tracer::Span span("gateway", "gateway", gateway.name);
+    authenticate();
+
+    // never repeat this on resume, it would delete the parts that were already pushed
+    if (config.remove_all_threat_feeds_on_run && !journal.has_phase("old_feeds_removed")) {
+        log() << "Removing old threat feeds..." << std::endl;
+        remove_all_custom_threat_feeds();
+        journal.complete_phase("old_feeds_removed");
+    }
+
+    if (!journal.has_phase("feeds_created")) {
+        log() << "Creating threat feed containers..." << std::endl;
+        create_threat_feeds();
+        journal.complete_phase("feeds_created");
+    }
+
+    log() << "Pushing threat feeds..." << std::endl;
+    update_threat_feeds();
+
+    log() << "Updating firewall policies..." << std::endl;
+    enable_filters_and_policies();
+    journal.complete_phase("complete");
+}
+
+std::ostream& Gateway::log(std::ostream& os) const { return os << '[' << gateway.name << "] "; }
+
+void Gateway::authenticate() const {
+    const auto& fortigate = gateway.fortigate;
+    FortiAuth::set_gateway_ip(fortigate.gateway_ip);
+    FortiAuth::set_admin_https_port(fortigate.admin_https_port);
+    FortiAuth::set_ca_cert_path(fortigate.certificates.ca_cert_path);
+    FortiAuth::set_ssl_cert_path(fortigate.certificates.ssl_cert_path);
+    FortiAuth::set_api_key(fortigate.api_key);
+    FortiAuth::set_cert_password(fortigate.certificates.ssl_cert_password);
+}
+
+void Gateway::create_threat_feeds() const {
+    for (unsigned int security_level = 0; security_level < build.info_by_security_level.size(); ++security_level) {
+        auto& info = build.info_by_security_level[security_level];
+        auto category = info.category_base;
+        for (unsigned int file_index = 0; file_index < info.file_count; ++file_index) {
+            auto filename = config.naming_convention.file_name(security_level, file_index + 1);
+            if (!ThreatFeed::contains(filename)) ThreatFeed::add(filename, category);
+            ++category;
+        }
+    }
+}
+
+void Gateway::update_threat_feeds() {
+    for (unsigned int security_level = 0; security_level < build.parts_by_security_level.size(); ++security_level) {
+        auto& parts = build.parts_by_security_level[security_level];
+        auto unpushed = journal.unpushed_parts(parts);
+        if (unpushed.size() < parts.size())
+            log() << "Already pushed, skipping " << parts.size() - unpushed.size() << " part(s) of security level "
+                  << security_level << std::endl;
+
+        for (const auto* part : unpushed) {
+            {
+                Tracer::Span span("upload", "gateway", part->filename, part->lines.size());
+                ThreatFeed::update_feed({{part->filename, part->lines}});
+            }
+            journal.record_part(part->filename, Journal::part_hash(part->lines));
+            log() << "Successfully pushed to Fortigate: " << part->filename << std::endl;
+        }
+        remove_extra_files(security_level, parts.size() + 1);
+    }
+}
+
+void Gateway::enable_filters_and_policies() const {
+    for (const auto& dns_config : gateway.forti_hole_automated_dns_filters) {
+        if (!DNSFilter::contains(dns_config.dns_filter)) DNSFilter::add(dns_config.dns_filter);
+
+        auto dns_filter = DNSFilter::get(dns_config.dns_filter);
+        auto& firewall_policies = dns_config.firewall_policies;
+        auto& filters = dns_config.filters;
+
+        // enable dns filters for threat feed categories
+        for (const auto& filter : filters) {
+            auto security_level = filter.security_level;
+            auto info = build.info_by_security_level.at(security_level);
+            auto category = info.category_base;
+
+            for (unsigned int file_index = 0; file_index < info.file_count; ++file_index) {
+                if (filter.access == "block") dns_filter.block_category(category);
+                else if (filter.access == "allow") dns_filter.allow_category(category);
+                else if (filter.access == "monitor") dns_filter.monitor_category(category);
+                else throw std::runtime_error("Not a valid DNSFilter setting: " + filter.access);
+                ++category;
+            }
+        }
+
+        DNSFilter::update(dns_filter);
+
+        // enable the dns filter in request firewall policies
+        for (const auto& policy_name : firewall_policies) {
+            auto policy = FortiGate::Policy::get(policy_name);
+            policy.dnsfilter_profile = dns_filter.name;
+            FortiGate::Policy::update(policy);
+        }
+    }
+}
+
+void Gateway::remove_all_custom_threat_feeds() const {
+    auto size = ThreatFeed::get().size();
+    for (const auto& connector : ThreatFeed::get()) {
+        auto name = connector.name;
+        log() << "Deleting: " << name << std::endl;
+        ThreatFeed::del(name);
+    }
+    log() << "Successfully removed " << size << " threat feeds..." << std::endl;
+    assert(ThreatFeed::get().empty());
+}
+
+void Gateway::remove_extra_files(unsigned int security_level, unsigned int file_index) const {
+    while (true) {
+        auto filename = config.naming_convention.file_name(security_level, file_index);
+        if (!ThreatFeed::contains(filename)) return;
+        ThreatFeed::del(filename);
+        ++file_index;
+    }
+}
+
+std::vector<int> run_forked(size_t jobs, size_t concurrency, const std::function<int(size_t)>& job) {
+    std::unordered_map<pid_t, size_t> running;
+    std::vector<int> exit_codes(jobs, -1);
+    concurrency = std::max<size_t>(concurrency, 1);
+
+    // polls our own children only, waitpid(-1) would also reap children the caller forked for other reasons
+    auto reap_one = [&]() {
+        while (true) {
+            for (auto it = running.begin(); it != running.end(); ++it) {
+                int status = 0;
+                pid_t pid;
+                do pid = waitpid(it->first, &status, WNOHANG);
+                while (pid < 0 && errno == EINTR);
+                if (pid < 0) throw std::runtime_error("waitpid() failed: " + std::string(std::strerror(errno)));
+                if (pid == 0) continue;
+
+                exit_codes[it->second] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                running.erase(it);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    };
+
+    for (size_t i = 0; i < jobs; ++i) {
+        while (running.size() >= concurrency) reap_one();
+
+        std::cout.flush();
+        std::cerr.flush();
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "fork() failed: " << std::strerror(errno) << std::endl;
+            continue;
+        }
+
+        if (pid == 0) {
+            int code = EXIT_FAILURE;
+            try { code = job(i); }
+            catch (const std::exception& e) { std::cerr << e.what() << std::endl; }
+            std::cout.flush();
+            std::cerr.flush();
+            _exit(code);
+        }
+
+        running.emplace(pid, i);
+    }
+
+    while (!running.empty()) reap_one();
+    return exit_codes;
+}
@@ -0,0 +1,198 @@
+#include "include/Journal.h"
+#include "include/hash.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+void write_file_atomically(const std::filesystem::path& path, std::string_view data) {
+    auto tmp = path;
+    tmp += ".tmp";
+
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("Failed to open " + tmp.string() + ": " + std::strerror(errno));
+
+    size_t written = 0;
+    while (written < data.size()) {
+        auto n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to write " + tmp.string() + ": " + std::strerror(errno));
+        }
+        written += static_cast<size_t>(n);
+    }
+
+    if (::fsync(fd) != 0 || ::close(fd) != 0)
+        throw std::runtime_error("Failed to flush " + tmp.string() + ": " + std::strerror(errno));
+
+    std::filesystem::rename(tmp, path);
+
+    // the rename itself is only durable once the directory entry is
+    auto parent = path.parent_path();
+    int dir_fd = ::open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) throw std::runtime_error("Failed to open " + parent.string() + ": " + std::strerror(errno));
+    int rc = ::fsync(dir_fd);
+    ::close(dir_fd);
+    if (rc != 0) throw std::runtime_error("Failed to flush " + parent.string() + ": " + std::strerror(errno));
+}
+
+static std::string read_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+Journal::Journal(std::filesystem::path path) : path(std::move(path)), state(nlohmann::json::object()) {
+    if (!std::filesystem::exists(this->path)) return;
+    try { state = nlohmann::json::parse(read_file(this->path)); }
+    catch (const nlohmann::json::exception& e) {
+        std::cerr << "Ignoring unreadable journal " << this->path << ": " << e.what() << std::endl;
+        state = nlohmann::json::object();
+    }
+}
+
+void Journal::persist() const {
+    if (path.empty()) return;
+    write_file_atomically(path, state.dump());
+}
+
+void Journal::reset(nlohmann::json header) {
+    state = {{"header", std::move(header)}, {"phases", nlohmann::json::array()}, {"parts", nlohmann::json::object()}};
+    persist();
+}
+
+void Journal::remove() {
+    state = nlohmann::json::object();
+    if (!path.empty()) std::filesystem::remove(path);
+}
+
+const nlohmann::json& Journal::header() const {
+    static const nlohmann::json empty = nlohmann::json::object();
+    return state.contains("header") ? state["header"] : empty;
+}
+
+bool Journal::resumable(uint64_t config_hash, std::chrono::seconds max_age,
+                        std::chrono::system_clock::time_point now) const {
+    if (!exists() || !has_phase("built") || has_phase("complete")) return false;
+
+    if (header().value("config_hash", uint64_t{0}) != config_hash) {
+        std::cout << "Config changed since the interrupted run, starting over..." << std::endl;
+        return false;
+    }
+
+    std::chrono::system_clock::time_point started_at(std::chrono::seconds(header().value("started_at", int64_t{0})));
+    if (now - started_at > max_age) {
+        std::cout << "Interrupted run is too old to resume, starting over..." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Journal::has_phase(const std::string& phase) const {
+    if (!state.contains("phases")) return false;
+    const auto& phases = state["phases"];
+    return std::find(phases.begin(), phases.end(), phase) != phases.end();
+}
+
+void Journal::complete_phase(const std::string& phase) {
+    if (has_phase(phase)) return;
+    state["phases"].push_back(phase);
+    persist();
+}
+
+bool Journal::has_part(const std::string& filename, uint64_t hash) const {
+    if (!state.contains("parts")) return false;
+    auto it = state["parts"].find(filename);
+    return it != state["parts"].end() && it->get<uint64_t>() == hash;
+}
+
+void Journal::record_part(const std::string& filename, uint64_t hash) {
+    state["parts"][filename] = hash;
+    persist();
+}
+
+std::vector<const ThreatFeedPart*> Journal::unpushed_parts(const std::vector<ThreatFeedPart>& parts) const {
+    std::vector<const ThreatFeedPart*> unpushed;
+    for (const auto& part : parts)
+        if (!has_part(part.filename, part_hash(part.lines))) unpushed.push_back(&part);
+    return unpushed;
+}
+
+uint64_t Journal::part_hash(const std::vector<std::string>& lines) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const auto& line : lines) hash = fnv1a_64("\n", fnv1a_64(line, hash));
+    return hash;
+}
+
+void BuildCache::save(const std::filesystem::path& dir, const ThreatFeedBuild& build) {
+    std::filesystem::create_directories(dir / "parts");
+
+    auto manifest = nlohmann::json::array();
+    for (size_t security_level = 0; security_level < build.info_by_security_level.size(); ++security_level) {
+        const auto& info = build.info_by_security_level[security_level];
+        auto parts = nlohmann::json::array();
+
+        for (const auto& part : build.parts_by_security_level[security_level]) {
+            std::string content;
+            for (const auto& line : part.lines) content.append(line).push_back('\n');
+            write_file_atomically(dir / "parts" / (part.filename + ".txt"), content);
+            parts.push_back({{"filename", part.filename},
+                             {"lines", part.lines.size()},
+                             {"hash", Journal::part_hash(part.lines)}});
+        }
+
+        manifest.push_back({{"total_lines", info.total_lines},
+                            {"file_count", info.file_count},
+                            {"category_base", info.category_base},
+                            {"parts", std::move(parts)}});
+    }
+
+    write_file_atomically(dir / "exceptions.json", nlohmann::json(build.source_exceptions).dump());
+
+    // the manifest goes last, a cache without one is never loaded
+    write_file_atomically(dir / "build.json", manifest.dump());
+}
+
+std::optional<ThreatFeedBuild> BuildCache::load(const std::filesystem::path& dir) {
+    if (!std::filesystem::exists(dir / "build.json")) return std::nullopt;
+
+    try {
+        auto manifest = nlohmann::json::parse(read_file(dir / "build.json"));
+        ThreatFeedBuild build;
+
+        for (const auto& level : manifest) {
+            build.info_by_security_level.emplace_back(level["total_lines"].get<unsigned int>(),
+                                                      level["file_count"].get<unsigned int>(),
+                                                      level["category_base"].get<unsigned int>());
+
+            auto& parts = build.parts_by_security_level.emplace_back();
+            for (const auto& entry : level["parts"]) {
+                ThreatFeedPart part{entry["filename"].get<std::string>(), {}};
+                part.lines.reserve(entry["lines"].get<size_t>());
+
+                std::istringstream content(read_file(dir / "parts" / (part.filename + ".txt")));
+                for (std::string line; std::getline(content, line);) part.lines.push_back(std::move(line));
+
+                if (Journal::part_hash(part.lines) != entry["hash"].get<uint64_t>()) {
+                    std::cerr << "Cached part failed verification: " << part.filename << std::endl;
+                    return std::nullopt;
+                }
+                parts.push_back(std::move(part));
+            }
+        }
+
+        if (std::filesystem::exists(dir / "exceptions.json"))
+            build.source_exceptions = nlohmann::json::parse(read_file(dir / "exceptions.json"));
+        return build;
+    } catch (const nlohmann::json::exception& e) {
+        std::cerr << "Ignoring unreadable build cache " << dir << ": " << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,62 @@
+#include "include/MappedFile.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to stat " + path.string() + ": " + std::strerror(error));
+    }
+
+    // mmap() rejects empty mappings, an empty list is simply an empty view
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Failed to map " + path.string() + ": " + std::strerror(error));
+        }
+        data = static_cast<const char*>(mapping);
+
+        // advice only, a kernel that ignores it still serves the pages
+        ::madvise(mapping, length, MADV_WILLNEED);
+        ::madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+
+    // the mapping keeps the file referenced
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data) ::munmap(const_cast<char*>(data), length);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+        data(std::exchange(other.data, nullptr)), length(std::exchange(other.length, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        if (data) ::munmap(const_cast<char*>(data), length);
+        data = std::exchange(other.data, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+size_t MappedFile::page_size() {
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
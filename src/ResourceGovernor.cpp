@@ -0,0 +1,251 @@
+#include "include/ResourceGovernor.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static constexpr unsigned int MAX_CPU = 1023;  // CPU_SETSIZE - 1
+
+void ResourceOverrides::apply_to(ResourceConfig& resources) const {
+    if (threads) resources.threads = *threads;
+    if (memory_limit_mb) resources.memory_limit_mb = *memory_limit_mb;
+    if (io_priority_level) resources.io_priority_level = *io_priority_level;
+    if (nice) resources.nice = *nice;
+    if (cpu_affinity) resources.cpu_affinity = *cpu_affinity;
+    if (io_priority_class) resources.io_priority_class = *io_priority_class;
+}
+
+static std::optional<std::string> read_line(const fs::path& path) {
+    std::ifstream in(path);
+    std::string line;
+    if (!in || !std::getline(in, line)) return std::nullopt;
+    return line;
+}
+
+// the whole of text, or nothing; never throws, a malformed cgroup file must not take the run down
+template<typename T>
+static std::optional<T> parse_number(std::string_view text) {
+    T value{};
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) return std::nullopt;
+    return value;
+}
+
+// (controllers, path) pairs of /proc/self/cgroup; the v2 unified hierarchy has an empty controller list
+static std::vector<std::pair<std::string, std::string>> cgroup_entries(const fs::path& self) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::ifstream in(self);
+    for (std::string line; std::getline(in, line);) {
+        auto first = line.find(':'), second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) continue;
+        entries.emplace_back(line.substr(first + 1, second - first - 1), line.substr(second + 1));
+    }
+    return entries;
+}
+
+// Directories from the process' own cgroup up to the mount root. Limits set on any ancestor apply too.
+// Inside a cgroup namespace the listed path may not exist under the mount, then only the root is checked.
+static std::vector<fs::path> cgroup_chain(const fs::path& mount, const std::string& path) {
+    std::vector<fs::path> chain;
+    auto dir = mount / fs::path(path).relative_path();
+    if (!fs::exists(dir)) dir = mount;
+    for (; dir.string().starts_with(mount.string()); dir = dir.parent_path()) {
+        chain.push_back(dir);
+        if (dir == mount) break;
+    }
+    return chain;
+}
+
+static std::optional<fs::path> v1_mount(const fs::path& root, const std::string& controller) {
+    for (const auto& name : {controller, std::string("cpu,cpuacct"), std::string("cpuacct,cpu")})
+        if (fs::exists(root / name)) return root / name;
+    return std::nullopt;
+}
+
+static bool has_controller(const std::string& controllers, const std::string& controller) {
+    std::stringstream stream(controllers);
+    for (std::string item; std::getline(stream, item, ',');) if (item == controller) return true;
+    return false;
+}
+
+std::optional<double> ResourceGovernor::cgroup_cpu_limit(const fs::path& root, const fs::path& self) {
+    std::optional<double> limit;
+    auto tighten = [&limit](double cpus) { if (cpus > 0) limit = std::min(limit.value_or(cpus), cpus); };
+
+    for (const auto& [controllers, path] : cgroup_entries(self)) {
+        if (controllers.empty()) {
+            for (const auto& dir : cgroup_chain(root, path)) {
+                auto line = read_line(dir / "cpu.max");  // "<quota> <period>" or "max <period>"
+                if (!line || line->starts_with("max")) continue;
+                double quota = 0, period = 0;
+                std::istringstream(*line) >> quota >> period;
+                if (period > 0) tighten(quota / period);
+            }
+        } else if (has_controller(controllers, "cpu")) {
+            auto mount = v1_mount(root, "cpu");
+            if (!mount) continue;
+            for (const auto& dir : cgroup_chain(*mount, path)) {
+                auto quota = read_line(dir / "cpu.cfs_quota_us"), period = read_line(dir / "cpu.cfs_period_us");
+                auto q = quota ? parse_number<double>(*quota) : std::nullopt;
+                auto p = period ? parse_number<double>(*period) : std::nullopt;
+                if (q && p && *q > 0 && *p > 0) tighten(*q / *p);
+            }
+        }
+    }
+
+    return limit;
+}
+
+std::optional<uint64_t> ResourceGovernor::cgroup_memory_limit(const fs::path& root, const fs::path& self) {
+    std::optional<uint64_t> limit;
+    auto tighten = [&limit](uint64_t bytes) { limit = std::min(limit.value_or(bytes), bytes); };
+
+    for (const auto& [controllers, path] : cgroup_entries(self)) {
+        if (controllers.empty()) {
+            for (const auto& dir : cgroup_chain(root, path)) {
+                auto line = read_line(dir / "memory.max");  // "max" does not parse either
+                if (auto bytes = line ? parse_number<uint64_t>(*line) : std::nullopt) tighten(*bytes);
+            }
+        } else if (has_controller(controllers, "memory") && fs::exists(root / "memory")) {
+            for (const auto& dir : cgroup_chain(root / "memory", path)) {
+                auto line = read_line(dir / "memory.limit_in_bytes");
+                auto bytes = line ? parse_number<uint64_t>(*line) : std::nullopt;
+                if (bytes && *bytes < (uint64_t{1} << 60)) tighten(*bytes);  // v1 "unlimited"
+            }
+        }
+    }
+
+    return limit;
+}
+
+unsigned int ResourceGovernor::available_cpus() {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) return std::max(CPU_COUNT(&set), 1);
+#endif
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+unsigned int ResourceGovernor::parse_unsigned(const std::string& value) {
+    if (value.empty() || !std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); }))
+        throw std::invalid_argument("Not a non-negative integer: " + value);
+    auto parsed = std::stoull(value);
+    if (parsed > std::numeric_limits<unsigned int>::max()) throw std::out_of_range("Out of range: " + value);
+    return static_cast<unsigned int>(parsed);
+}
+
+std::vector<unsigned int> ResourceGovernor::parse_cpu_list(const std::string& list) {
+    std::vector<unsigned int> cpus;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (item.empty()) continue;
+        auto dash = item.find('-');
+        unsigned int first = parse_unsigned(item.substr(0, dash));
+        unsigned int last = dash == std::string::npos ? first : parse_unsigned(item.substr(dash + 1));
+        if (last < first) throw std::invalid_argument("Not a valid CPU range: " + item);
+        if (last > MAX_CPU) throw std::invalid_argument("CPU index out of range: " + std::to_string(last));
+        for (auto cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+static void apply_affinity(const std::vector<unsigned int>& cpus) {
+    if (cpus.empty()) return;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        std::cerr << "sched_setaffinity() failed: " << std::strerror(errno) << std::endl;
+#endif
+}
+
+// Allocations past the cap fail with std::bad_alloc, so an oversized run dies on its own
+// instead of pushing the host (or the cgroup) into the OOM killer. A cap above the cgroup's would never be
+// reached before the OOM killer, so it is lowered to the cgroup's.
+static void apply_memory_limit(unsigned int memory_limit_mb) {
+    if (memory_limit_mb == 0) return;
+    rlim_t bytes = static_cast<rlim_t>(memory_limit_mb) << 20;
+    if (auto cgroup = ResourceGovernor::cgroup_memory_limit(); cgroup && *cgroup < bytes) {
+        std::cerr << "resources.memory_limit_mb (" << memory_limit_mb << ") exceeds the cgroup memory limit ("
+                  << (*cgroup >> 20) << " MiB), capping at the cgroup limit" << std::endl;
+        bytes = static_cast<rlim_t>(*cgroup);
+    }
+    rlimit limit{bytes, bytes};
+    if (setrlimit(RLIMIT_DATA, &limit) != 0)
+        throw std::runtime_error(std::string("setrlimit(RLIMIT_DATA) failed: ") + std::strerror(errno));
+}
+
+static void apply_nice(int nice) {
+    if (nice == 0) return;
+    if (setpriority(PRIO_PROCESS, 0, nice) != 0)
+        std::cerr << "setpriority(" << nice << ") failed: " << std::strerror(errno) << std::endl;
+}
+
+static int io_priority_class_id(const std::string& io_class) {
+    if (io_class == "realtime") return 1;
+    if (io_class == "best-effort") return 2;
+    if (io_class == "idle") return 3;
+    throw std::invalid_argument("Not a valid resources.io_priority_class: " + io_class);
+}
+
+static void apply_io_priority(const std::string& io_class, [[maybe_unused]] unsigned int level) {
+    if (io_class.empty()) return;
+
+#ifdef __linux__
+    int class_id = io_priority_class_id(io_class);
+    constexpr int IOPRIO_WHO_PROCESS = 1, IOPRIO_CLASS_SHIFT = 13;
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, class_id << IOPRIO_CLASS_SHIFT | static_cast<int>(level)) != 0)
+        std::cerr << "ioprio_set(" << io_class << ") failed: " << std::strerror(errno) << std::endl;
+#endif
+}
+
+// Linux keeps affinity, nice and io priority per thread, so these only touch the thread that calls them.
+void ResourceGovernor::apply_to_thread(const ResourceConfig& resources) {
+    apply_affinity(resources.cpu_affinity);
+    apply_nice(resources.nice);
+    apply_io_priority(resources.io_priority_class, resources.io_priority_level);
+}
+
+unsigned int ResourceGovernor::apply(const ResourceConfig& resources) {
+    // workers apply the rest without a way to report errors, so bad values are rejected here
+    for (auto cpu : resources.cpu_affinity)
+        if (cpu > MAX_CPU) throw std::invalid_argument("CPU index out of range: " + std::to_string(cpu));
+    if (!resources.io_priority_class.empty()) io_priority_class_id(resources.io_priority_class);
+    if (resources.io_priority_level > 7) throw std::invalid_argument("resources.io_priority_level must be 0-7");
+#ifndef __linux__
+    if (!resources.cpu_affinity.empty() || !resources.io_priority_class.empty())
+        std::cerr << "resources.cpu_affinity and io_priority_class are only supported on Linux, ignoring" << std::endl;
+#endif
+
+    apply_memory_limit(resources.memory_limit_mb);
+
+    if (resources.threads > 0) return resources.threads;
+
+    // a 1.5 CPU quota still gets 2 workers, rounding down would leave half the quota idle
+    unsigned int threads = available_cpus();
+    if (!resources.cpu_affinity.empty())
+        threads = std::min(threads, static_cast<unsigned int>(resources.cpu_affinity.size()));
+    if (auto quota = cgroup_cpu_limit())
+        threads = std::min(threads, std::max(1U, static_cast<unsigned int>(std::ceil(*quota))));
+    return threads;
+}
@@ -0,0 +1,159 @@
+#include "include/Sketch.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <map>
+
+void HyperLogLog::add(uint64_t hash) {
+    auto index = hash >> (64 - PRECISION);
+
+    // the sentinel bit caps the rank when every remaining bit is zero
+    auto rank = static_cast<uint8_t>(std::countl_zero((hash << PRECISION) | (uint64_t{1} << (PRECISION - 1))) + 1);
+    if (rank > registers[index]) registers[index] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < REGISTERS; ++i) registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+double HyperLogLog::estimate() const {
+    constexpr auto m = static_cast<double>(REGISTERS);
+    constexpr double alpha = 0.7213 / (1.0 + 1.079 / m);
+
+    double sum = 0;
+    size_t zeros = 0;
+    for (auto value : registers) {
+        sum += std::ldexp(1.0, -value);
+        if (value == 0) ++zeros;
+    }
+
+    double estimate = alpha * m * m / sum;
+
+    // linear counting is far more accurate while registers are still empty
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * std::log(m / static_cast<double>(zeros));
+    return estimate;
+}
+
+void MinHash::merge(const MinHash& other) {
+    for (size_t i = 0; i < BINS; ++i) minimums[i] = std::min(minimums[i], other.minimums[i]);
+}
+
+double MinHash::jaccard(const MinHash& other) const {
+    constexpr auto empty = std::numeric_limits<uint64_t>::max();
+
+    // bins empty in both sets say nothing about the overlap
+    size_t matches = 0, compared = 0;
+    for (size_t i = 0; i < BINS; ++i) {
+        if (minimums[i] == empty && other.minimums[i] == empty) continue;
+        ++compared;
+        if (minimums[i] == other.minimums[i]) ++matches;
+    }
+    return compared ? static_cast<double>(matches) / static_cast<double>(compared) : 0.0;
+}
+
+void DomainSketch::merge(const DomainSketch& other) {
+    domains.merge(other.domains);
+    minhash.merge(other.minhash);
+}
+
+nlohmann::json source_report(const std::vector<std::shared_ptr<SourceSketch>>& sketches, double min_jaccard,
+                             size_t max_overlaps) {
+    // exclusive = |all sources| - |all sources but this one|, with "all but i" = prefix[0, i) + suffix(i, n),
+    // so it takes n merges instead of n², at the cost of holding one 16 KiB suffix per source
+    std::vector<HyperLogLog> suffixes(sketches.size() + 1);
+    for (size_t i = sketches.size(); i-- > 0;) {
+        suffixes[i] = suffixes[i + 1];
+        suffixes[i].merge(sketches[i]->sketch.domains);
+    }
+    const double total = suffixes.front().estimate();
+
+    // contributed = |this ∪ lower levels| - |lower levels|, with one union per security level
+    std::map<unsigned int, HyperLogLog> below;
+    for (const auto& sketch : sketches) below.try_emplace(sketch->security_level);
+    for (const auto& sketch : sketches)
+        for (auto it = below.upper_bound(sketch->security_level); it != below.end(); ++it)
+            it->second.merge(sketch->sketch.domains);
+
+    // Comparing every pair is unavoidable, keeping them is not: each source keeps a bounded min-heap of its
+    // closest matches, so memory stays O(n * max_overlaps) even when thousands of mirrors all overlap.
+    using Overlap = std::pair<double, size_t>;  // jaccard, other index
+    constexpr auto closer = [](const Overlap& a, const Overlap& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+    std::vector<std::vector<Overlap>> closest(sketches.size());
+    auto keep = [&](size_t i, Overlap overlap) {
+        auto& heap = closest[i];
+        if (heap.size() == max_overlaps) {
+            if (max_overlaps == 0 || !closer(overlap, heap.front())) return;
+            std::pop_heap(heap.begin(), heap.end(), closer);
+            heap.pop_back();
+        }
+        heap.push_back(overlap);
+        std::push_heap(heap.begin(), heap.end(), closer);
+    };
+    for (size_t i = 0; i < sketches.size(); ++i) {
+        for (size_t j = i + 1; j < sketches.size(); ++j) {
+            double jaccard = sketches[i]->sketch.minhash.jaccard(sketches[j]->sketch.minhash);
+            if (jaccard < min_jaccard) continue;
+            keep(i, {jaccard, j});
+            keep(j, {jaccard, i});
+        }
+    }
+
+    HyperLogLog prefix;
+    nlohmann::json sources = nlohmann::json::array();
+    for (size_t i = 0; i < sketches.size(); ++i) {
+        const auto& sketch = sketches[i]->sketch;
+
+        HyperLogLog others = prefix;
+        others.merge(suffixes[i + 1]);
+        prefix.merge(sketch.domains);
+
+        std::sort(closest[i].begin(), closest[i].end(), closer);
+        nlohmann::json overlaps = nlohmann::json::array();
+        for (const auto& [jaccard, j] : closest[i])
+            overlaps.push_back({{"index", j}, {"source", sketches[j]->source}, {"jaccard", jaccard}});
+
+        auto domains = sketch.domains.estimate();
+        const auto& lower = below.at(sketches[i]->security_level);
+        HyperLogLog with_lower = lower;
+        with_lower.merge(sketch.domains);
+
+        sources.push_back({
+            {"source", sketches[i]->source},
+            {"security_level", sketches[i]->security_level},
+            {"domains", std::llround(domains)},
+            {"contributed", std::llround(std::clamp(with_lower.estimate() - lower.estimate(), 0.0, domains))},
+            {"exclusive", std::llround(std::clamp(total - others.estimate(), 0.0, domains))},
+            {"overlaps", overlaps}
+        });
+    }
+
+    return {{"total_domains", std::llround(total)}, {"sources", sources}};
+}
+
+void write_source_report(const std::filesystem::path& path, const nlohmann::json& report,
+                         const std::vector<std::shared_ptr<SourceSketch>>& sketches) {
+    const std::filesystem::path tmp = path.string() + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Failed to open " + tmp.string());
+
+    const auto& sources = report.at("sources");
+    out << "{\"total_domains\": " << report.at("total_domains").dump() << ",\n\"sources\": [";
+    std::vector<double> row(sketches.size());
+    for (size_t i = 0; i < sketches.size(); ++i) {
+        // three decimals are well below MinHash's ~6% error and keep the n² matrix small
+        for (size_t j = 0; j < sketches.size(); ++j)
+            row[j] = std::round(sketches[i]->sketch.minhash.jaccard(sketches[j]->sketch.minhash) * 1000) / 1000;
+
+        auto entry = sources.at(i);
+        entry["jaccard"] = row;
+        out << (i ? ",\n" : "\n") << entry.dump();
+    }
+    out << "\n]}\n";
+
+    out.close();
+    if (!out) throw std::runtime_error("Failed to write " + tmp.string());
+    std::filesystem::rename(tmp, path);
+}
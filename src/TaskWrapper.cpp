@@ -4,28 +4,41 @@
 
 #include "include/TaskWrapper.h"
 #include "include/Task.h"
-#include <functional>
+#include "include/Tracer.h"
+#include <exception>
+#include <utility>
 
 TaskWrapper::TaskWrapper(std::unique_ptr<Task> t) : task(std::move(t)) {}
 
 TaskWrapper::TaskWrapper(TaskWrapper &&other) noexcept
-    : task(std::move(other.task)), promise(std::move(other.promise)) {}
+    : task(std::move(other.task)), promise(std::move(other.promise)), enqueued(other.enqueued) {}
 
 TaskWrapper &TaskWrapper::operator=(TaskWrapper &&other) noexcept {
     if (this != &other) {
         task = std::move(other.task);
         promise = std::move(other.promise);
+        enqueued = other.enqueued;
     }
     return *this;
 }
 
 void TaskWrapper::operator()() {
+    const int64_t start = Tracer::enabled() ? Tracer::now() : -1;
+    ExpectedFuture result;
+    std::exception_ptr error;
     try {
-        std::function<ExpectedFuture()> func = [this]() mutable -> ExpectedFuture { return task->operator()(); };
-        if (func) promise.set_value(func());
+        result = task->operator()();
     } catch (...) {
-        promise.set_exception(std::current_exception());
+        error = std::current_exception();
     }
+
+    // recorded before the promise is fulfilled, so a flush() right after future.get() already sees the task
+    if (start >= 0) Tracer::record(task->name(), "task", start, Tracer::now(), task->payload_size(), enqueued);
+
+    if (error) promise.set_exception(error);
+    else promise.set_value(std::move(result));
 }
 
+void TaskWrapper::mark_enqueued() { if (Tracer::enabled()) enqueued = Tracer::now(); }
+
 std::future<ExpectedFuture> TaskWrapper::getFuture() { return promise.get_future(); }
@@ -3,13 +3,15 @@
 //
 
 #include "include/ThreadPool.h"
+#include "include/Tracer.h"
 #include <algorithm>
 #include <utility>
 
-ThreadPool::ThreadPool()
+ThreadPool::ThreadPool(unsigned int num_threads, std::function<void()> on_worker_start)
         : stopFlag(std::atomic<bool>(false)),
-          numThreads(std::thread::hardware_concurrency()),
-          threads(numThreads) {
+          numThreads(std::max(num_threads, 1U)),
+          threads(numThreads),
+          on_worker_start(std::move(on_worker_start)) {
     for (auto& thread : threads) thread = std::thread(&ThreadPool::worker, this);
 }
 
@@ -22,12 +24,14 @@ ThreadPool::ThreadPool(const ThreadPool &rhs)
     : stopFlag(rhs.stopFlag.load()),
     numThreads(rhs.numThreads),
     threads(numThreads),
-    cv() {}
+    cv(),
+    on_worker_start(rhs.on_worker_start) {}
 
 ThreadPool& ThreadPool::operator=(const ThreadPool &rhs) {
     if (this != &rhs) {
         stopFlag = rhs.stopFlag.load();
         numThreads = rhs.numThreads;
+        on_worker_start = rhs.on_worker_start;
     }
     return *this;
 }
@@ -38,12 +42,15 @@ void ThreadPool::stop() {
 }
 
 void ThreadPool::submit(TaskWrapper &task) {
+    task.mark_enqueued();
     std::scoped_lock lock(mutex);
     queue.push(std::move(task));
     cv.notify_one();
 }
 
 void ThreadPool::worker() {
+    Tracer::set_thread_name("pool worker");
+    if (on_worker_start) on_worker_start();
     while (!stopFlag.load()) {
         std::unique_ptr<TaskWrapper> task;
         {
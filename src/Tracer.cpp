@@ -0,0 +1,239 @@
+#include "include/Tracer.h"
+#include "include/hash.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+    struct Event {
+        const char* name;
+        const char* category;
+        int64_t start, end, queued;
+        uint64_t payload;
+        std::string detail;
+    };
+
+    // append-only block list: the owning thread fills a slot and then publishes it through size, so flush()
+    // can walk a buffer while its thread keeps recording
+    struct Block {
+        static constexpr size_t CAPACITY = 4096;
+        std::array<Event, CAPACITY> events{};
+        std::atomic<size_t> size{0};
+        std::atomic<Block*> next{nullptr};
+    };
+
+    struct ThreadBuffer {
+        static constexpr size_t MAX_BLOCKS = 64;  // ~260k events per thread, beyond that events are counted and dropped
+
+        unsigned int tid;
+        std::string name;
+        bool retired{};  // its thread exited, freed by the next flush(); guarded by registry_mutex
+        Block head{};
+        Block* tail{&head};
+        size_t blocks{1};
+        std::atomic<uint64_t> dropped{0};
+
+        explicit ThreadBuffer(unsigned int tid) : tid(tid) {}
+
+        ~ThreadBuffer() { clear(); }
+
+        void clear() {
+            for (Block* block = head.next.exchange(nullptr); block;) delete std::exchange(block, block->next.load());
+            head.size.store(0);
+            tail = &head;
+            blocks = 1;
+            dropped.store(0);
+        }
+
+        void append(Event&& event) {
+            size_t size = tail->size.load(std::memory_order_relaxed);
+            if (size == Block::CAPACITY) {
+                if (blocks == MAX_BLOCKS) {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                auto* block = new Block();
+                tail->next.store(block, std::memory_order_release);
+                tail = block;
+                ++blocks;
+                size = 0;
+            }
+            tail->events[size] = std::move(event);
+            tail->size.store(size + 1, std::memory_order_release);
+        }
+    };
+
+    // Buffers outlive their threads until the next flush, so a flush after the pool is gone still sees every
+    // event while pools recreated by every DNS refresh do not pile up buffers.
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    unsigned int next_tid{1};
+    std::filesystem::path output_path;
+    std::string process_name{"forti-hole"};
+    int64_t origin{};
+
+    thread_local ThreadBuffer* local_buffer = nullptr;
+    thread_local std::string local_name;
+
+    // destroyed on thread exit, a buffer without events has nothing left to flush and goes right away
+    struct Retirer {
+        ~Retirer() {
+            std::scoped_lock lock(registry_mutex);
+            auto* retiring = std::exchange(local_buffer, nullptr);
+            retiring->retired = true;
+            if (retiring->head.size.load() == 0)
+                std::erase_if(registry, [retiring](const auto& registered) { return registered.get() == retiring; });
+        }
+    };
+
+    ThreadBuffer& buffer() {
+        if (!local_buffer) {
+            std::scoped_lock lock(registry_mutex);
+            auto& registered = registry.emplace_back(std::make_unique<ThreadBuffer>(next_tid++));
+            registered->name = local_name.empty() ? "thread " + std::to_string(registered->tid) : local_name;
+            local_buffer = registered.get();
+            thread_local Retirer retirer;
+        }
+        return *local_buffer;
+    }
+
+    void write_escaped(std::ostream& os, std::string_view text) {
+        os << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') os << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                os << escaped;
+            } else os << c;
+        }
+        os << '"';
+    }
+
+    // trace timestamps are microseconds
+    void write_us(std::ostream& os, int64_t ns) {
+        os << ns / 1000 << '.' << static_cast<char>('0' + ns / 100 % 10)
+           << static_cast<char>('0' + ns / 10 % 10) << static_cast<char>('0' + ns % 10);
+    }
+}
+
+void Tracer::enable(const std::filesystem::path& path) {
+    {
+        std::scoped_lock lock(registry_mutex);
+        output_path = path;
+        if (origin == 0) origin = now();
+    }
+    detail::enabled_flag.store(true);
+}
+
+int64_t Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::set_thread_name(std::string name) {
+    if (local_buffer) {
+        std::scoped_lock lock(registry_mutex);
+        local_buffer->name = std::move(name);
+    } else local_name = std::move(name);
+}
+
+void Tracer::record(const char* name, const char* category, int64_t start, int64_t end,
+                    uint64_t payload, int64_t queued, std::string_view detail) {
+    if (!enabled()) return;
+    buffer().append({name, category, start, end, queued, payload, std::string(detail)});
+}
+
+void Tracer::after_fork(std::string_view suffix) {
+    if (!enabled()) return;
+
+    // the child is single threaded, nothing else can be appending
+    std::scoped_lock lock(registry_mutex);
+    for (auto& registered : registry) registered->clear();
+
+    auto stem = output_path.stem().string();
+    output_path.replace_filename(stem + '.' + file_safe_name(suffix) + output_path.extension().string());
+    process_name = "forti-hole " + std::string(suffix);
+}
+
+void Tracer::flush() {
+    if (!enabled()) return;
+
+    std::scoped_lock lock(registry_mutex);
+    const std::filesystem::path tmp = output_path.string() + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to write trace: " << output_path << std::endl;
+        return;
+    }
+
+    const auto pid = getpid();
+    uint64_t events = 0, dropped = 0, async_id = 0;
+
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)" << '\n';
+    out << R"({"name":"process_name","ph":"M","pid":)" << pid << R"(,"tid":0,"args":{"name":)";
+    write_escaped(out, process_name);
+    out << "}}";
+
+    for (const auto& registered : registry) {
+        out << ",\n" << R"({"name":"thread_name","ph":"M","pid":)" << pid << R"(,"tid":)" << registered->tid
+            << R"(,"args":{"name":)";
+        write_escaped(out, registered->name);
+        out << "}}";
+
+        for (const Block* block = &registered->head; block; block = block->next.load(std::memory_order_acquire)) {
+            const size_t size = block->size.load(std::memory_order_acquire);
+            for (size_t i = 0; i < size; ++i, ++events) {
+                const auto& event = block->events[i];
+                out << ",\n" << R"({"name":")" << event.name << R"(","cat":")" << event.category
+                    << R"(","ph":"X","pid":)" << pid << R"(,"tid":)" << registered->tid << R"(,"ts":)";
+                write_us(out, event.start - origin);
+                out << R"(,"dur":)";
+                write_us(out, event.end - event.start);
+                out << R"(,"args":{"payload":)" << event.payload;
+                if (event.queued >= 0) {
+                    out << R"(,"queued_us":)";
+                    write_us(out, event.start - event.queued);
+                }
+                if (!event.detail.empty()) {
+                    out << R"(,"detail":)";
+                    write_escaped(out, event.detail);
+                }
+                out << "}}";
+
+                // queue wait as an async slice, these overlap freely and get their own tracks
+                if (event.queued >= 0) {
+                    ++async_id;
+                    for (auto [phase, ts] : {std::pair{'b', event.queued}, std::pair{'e', event.start}}) {
+                        out << ",\n" << R"({"name":")" << event.name << R"(","cat":"queue","ph":")" << phase
+                            << R"(","id":)" << async_id << R"(,"pid":)" << pid << R"(,"tid":)" << registered->tid
+                            << R"(,"ts":)";
+                        write_us(out, ts - origin);
+                        out << '}';
+                    }
+                }
+            }
+        }
+        dropped += registered->dropped.load();
+    }
+
+    out << "\n]}\n";
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write trace: " << output_path << std::endl;
+        return;
+    }
+    std::filesystem::rename(tmp, output_path);
+    std::erase_if(registry, [](const auto& registered) { return registered->retired; });
+
+    std::cout << "Wrote " << events << " trace events to " << output_path.string();
+    if (dropped) std::cout << " (" << dropped << " dropped, per-thread buffers full)";
+    std::cout << std::endl;
+}
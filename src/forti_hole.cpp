@@ -3,6 +3,12 @@
 //
 
 #include "include/forti_hole.h"
+#include "include/Gateway.h"
+#include "include/hash.h"
+#include "include/DNSResponder.h"
+#include "include/Decompressor.h"
+#include "include/Tracer.h"
+#include "include/MappedFile.h"
 #include <forti_api.hpp>
 #include <thread>
 #include <filesystem>
@@ -11,72 +17,278 @@
 #include <cstdlib>
 #include <memory>
 #include <functional>
+#include <cctype>
+#include <iterator>
+#include <tuple>
+#include <condition_variable>
+#include <stop_token>
+
+static constexpr std::string_view FILE_SCHEME = "file://";
 
 inline static const std::regex ipv4_subnet(
         R"(((([0-9]{1,3})\.){3}([0-9]{1,3}))\/([0-9]|[1-2][0-9]|3[0-2]))"); // Subnet CIDR for IPv4 (0-32)
 inline static const std::regex ipv6_subnet(
         R"((([0-9a-fA-F]{1,4}\:){7}[0-9a-fA-F]{1,4})\/([0-9]|[1-9][0-9]|1[0-1][0-9]|12[0-8]))"); // Subnet CIDR for IPv6 (0-128)
 
-FortiHole::FortiHole(const std::string& config_file) : config(YAML::LoadFile(config_file)) {
-    FortiAuth::set_gateway_ip(config.fortigate.gateway_ip);
-    FortiAuth::set_admin_https_port(config.fortigate.admin_https_port);
-    FortiAuth::set_ca_cert_path(config.fortigate.certificates.ca_cert_path);
-    FortiAuth::set_ssl_cert_path(config.fortigate.certificates.ssl_cert_path);
-    FortiAuth::set_api_key(config.fortigate.api_key);
-    FortiAuth::set_cert_password(config.fortigate.certificates.ssl_cert_password);
+FortiHole::FortiHole(const std::string& config_file, const ResourceOverrides& overrides) :
+        overrides(overrides),
+        config(load_config(config_file, overrides)),
+        threadPool(ResourceGovernor::apply(config.resources),
+                   [resources = config.resources]() { ResourceGovernor::apply_to_thread(resources); }) {
+    // The calling thread downloads, fsyncs, writes the output files and forks the gateway pushes, so it is part of
+    // the batch job too. In DNS mode it goes on to serve DNS instead, and serve_dns() applies the settings to the
+    // threads that do the rest.
+    if (!config.dns_server.enabled) ResourceGovernor::apply_to_thread(config.resources);
+
+    std::ifstream config_stream(config_file, std::ios::binary);
+    config_hash = fnv1a_64(std::string(std::istreambuf_iterator<char>(config_stream), {}));
+
+    // --trace wins over the config file
+    if (!config.trace_file.empty() && !Tracer::enabled()) Tracer::enable(config.trace_file);
     process_config();
 }
 
+Config FortiHole::load_config(const std::string& config_file, const ResourceOverrides& overrides) {
+    Config config(YAML::LoadFile(config_file));
+    overrides.apply_to(config.resources);
+    return config;
+}
+
 void FortiHole::operator()() {
     auto start = std::chrono::high_resolution_clock::now();
+    Tracer::Span run_span("run", "pipeline");
 
-    std::cout << "Starting blocklist scraping process...\n" << std::endl;
+    build_lists();
+    push();
 
-    std::cout << "Scraping blocklists...\n" << std::endl;
-    fetch_multi();
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
+    std::cout << "\nforti-hole finished successfully in " << duration.count() << 's' << std::endl;
+}
 
-    std::cout << "Parsing response data...\n" << std::endl;
-    process_multi();
+void FortiHole::build_lists() {
+    if (resume_from_journal()) {
+        std::cout << "Resuming interrupted run from " << config.journal.directory << "...\n" << std::endl;
+        if (config.source_report.enabled)
+            std::cout << "Skipping the source report, a resumed run reuses the cached build without parsing sources\n"
+                      << std::endl;
+    } else {
+        start_journal();
+
+        if (config.source_report.enabled)
+            for (const auto& request : requests)
+                source_sketches.push_back(std::make_shared<SourceSketch>(request.source, request.security_level));
+
+        std::cout << "Starting blocklist scraping process...\n" << std::endl;
+
+        std::cout << "Scraping blocklists...\n" << std::endl;
+        {
+            Tracer::Span span("fetch", "pipeline");
+            fetch_multi();
+        }
+
+        std::cout << "Parsing response data...\n" << std::endl;
+        {
+            Tracer::Span span("parse", "pipeline");
+            process_multi();
+            apply_source_exceptions();
+        }
+        report_sources();
+        source_sketches.clear();
+
+        if (config.write_files_to_disk && !std::filesystem::exists(config.output_dir)) {
+            std::cout << "Creating output directory: " << config.output_dir << std::endl;
+            std::filesystem::create_directories(config.output_dir);
+        }
+
+        std::cout << "Gathering threat feed information..." << std::endl;
+        build_threat_feed_info();
+
+        std::cout << "Constructing threat feed files..." << std::endl;
+        {
+            Tracer::Span span("build", "pipeline");
+            build_threat_feed_parts();
+        }
 
-    if (config.write_files_to_disk && !std::filesystem::exists(config.output_dir)) {
-        std::cout << "Creating output directory: " << config.output_dir << std::endl;
-        std::filesystem::create_directories(config.output_dir);
+        save_build_to_journal();
     }
+}
 
-    if (config.remove_all_threat_feeds_on_run) {
-        std::cout << "Removing old threat feeds...\n" << std::endl;
-        remove_all_custom_threat_feeds();
+void FortiHole::push() {
+    std::cout << "Pushing threat feeds to " << config.gateways.size() << " gateway(s)...\n" << std::endl;
+    {
+        Tracer::Span span("push", "pipeline");
+        push_to_gateways();
     }
+    finish_journal();
+}
 
-    std::cout << "Gathering threat feed information..." << std::endl;
-    build_threat_feed_info();
+std::shared_ptr<const DomainIndex> FortiHole::domain_index() const { return std::make_shared<DomainIndex>(build); }
 
-    std::cout << "Creating threat feed containers..." << std::endl;
-    create_threat_feeds();
+std::shared_ptr<const Allowlist> FortiHole::dns_allowlist() const {
+    auto combined = std::make_shared<Allowlist>(config.allowlist);
+    for (const auto& domain : build.source_exceptions) combined->allow_suffix(domain);
+    return combined;
+}
 
-    std::cout << "Constructing files and pushing threat feeds...\n" << std::endl;
-    update_threat_feeds();
+// Gateways are best effort while serving DNS, an unreachable FortiGate must not take name resolution down with it.
+static void push_for_dns(FortiHole& fortiHole) {
+    try { fortiHole.push(); }
+    catch (const std::exception& e) {
+        std::cerr << "Gateway push failed, DNS keeps serving the new blocklists: " << e.what() << std::endl;
+    }
+    Tracer::flush();
+}
+
+void FortiHole::serve_dns([[maybe_unused]] const std::string& config_file) {
+#ifndef __linux__
+    throw std::runtime_error("dns_server is only supported on Linux");
+#else
+    const auto dns_config = config.dns_server;
+
+    // this thread goes on to serve DNS with its normal scheduling, the build is batch work like the refreshes
+    std::async(std::launch::async, [this]() {
+        ResourceGovernor::apply_to_thread(config.resources);
+        build_lists();
+    }).get();
+
+    DNSResponder responder(dns_config, domain_index(), dns_allowlist());
+
+    std::cout << "\nDNS responder listening on " << dns_config.listen_address << ':' << responder.port()
+              << ", forwarding to " << dns_config.upstream << ':' << dns_config.upstream_port << std::endl;
+
+    // the responder serves from the calling thread while this one pushes and later refreshes
+    std::jthread refresher([&](std::stop_token stop) {
+        ResourceGovernor::apply_to_thread(config.resources);
+        push_for_dns(*this);
+
+        // the responder owns its own index, the scraping state is dead weight from here on
+        requests.clear();
+        lists_by_security_level.reset();
+        build = {};
+
+        if (dns_config.refresh_interval_hours == 0) return;
+
+        std::mutex mutex;
+        std::condition_variable_any cv;
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                cv.wait_for(lock, stop, std::chrono::hours(dns_config.refresh_interval_hours), []() { return false; });
+            }
+            if (stop.stop_requested()) return;
+
+            try {
+                FortiHole refresh(config_file, overrides);
+                refresh.build_lists();
+                responder.set_index(refresh.domain_index(), refresh.dns_allowlist());
+                std::cout << "DNS responder blocklists refreshed" << std::endl;
+                push_for_dns(refresh);
+            } catch (const std::exception& e) {
+                std::cerr << "Refresh failed, keeping the current blocklists: " << e.what() << std::endl;
+            }
+        }
+    });
 
-    std::cout << "Updating firewall policies..." << std::endl;
-    enable_filters_and_policies();
+    responder.serve();
+#endif
+}
 
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-    std::cout << "\nforti-hole finished successfully in " << duration.count() << 's' << std::endl;
+struct Download {
+    std::string& response;
+    Decompressor decompressor;
+    std::string content_encoding{}, error{};
+    bool started{};
+};
+
+// keeps the final response's Content-Encoding, every redirect hop starts a new status line
+size_t header_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* download = static_cast<Download*>(userdata);
+    std::string_view line(buffer, size * nitems);
+
+    constexpr std::string_view name = "content-encoding:";
+    if (line.starts_with("HTTP/")) download->content_encoding.clear();
+    else if (line.size() > name.size() && std::ranges::equal(line.substr(0, name.size()), name, [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == b;
+    }))
+        download->content_encoding = line.substr(name.size());
+    return size * nitems;
 }
 
+// decodes as the bytes arrive, so compressed sources never sit in memory in full
 size_t write_callback(void* ptr, size_t size, size_t nmemb, void* userdata) {
-    auto* data = static_cast<std::string*>(userdata);
-    data->append(static_cast<char*>(ptr), size * nmemb);
+    auto* download = static_cast<Download*>(userdata);
+    try {
+        if (!download->started) {
+            download->started = true;
+            download->decompressor.declare_encoding(download->content_encoding);
+        }
+        download->decompressor.feed(static_cast<char*>(ptr), size * nmemb, download->response);
+    }
+    catch (const std::exception& e) {
+        download->error = e.what();
+        return 0;  // aborts the transfer
+    }
     return size * nmemb;
 }
 
+// regular files below directory in a stable order, skipping dotfiles (rsync writes its temporaries as '.name.XXXXXX')
+static std::vector<std::filesystem::path> list_directory(const std::string& directory) {
+    std::vector<std::filesystem::path> paths;
+    if (directory.empty()) return paths;
+
+    if (!std::filesystem::is_directory(directory))
+        throw std::runtime_error("Blocklist directory does not exist: " + directory);
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file() && !entry.path().filename().string().starts_with('.'))
+            paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// uncompressed files are mapped and parsed in place, compressed ones are decoded out of the mapping
+static void load_local_file(FortiHoleRequest& request) {
+    const std::filesystem::path path = request.url.substr(FILE_SCHEME.size());
+    Tracer::Span span("map", "fetch", request.url);
+
+    try {
+        auto mapping = std::make_shared<const MappedFile>(path);
+        auto format = Decompressor::from_path(path.string());
+        if (format == Decompressor::Format::None) request.mapping = std::move(mapping);
+        else {
+            Decompressor decompressor(format);
+            auto data = mapping->view();
+            decompressor.feed(data.data(), data.size(), request.response);
+            decompressor.finish();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to read " << request.url << ": " << e.what() << std::endl;
+        request.mapping.reset();
+        request.response.clear();
+    }
+
+    span.set_payload(request.content().size());
+    std::cout << "Loaded " << request.content().size() / 1024 << " KiB" << std::endl;
+}
+
 void FortiHole::process_config() {
     std::cout << "Processing config file...\n" << std::endl;
+    std::cout << "Running with " << threadPool.size() << " worker thread(s)\n" << std::endl;
     unsigned int max_security = 0;
     for (const auto& entry : config.blocklist_sources) {
+        for (const auto& path : list_directory(entry.directory)) {
+            requests.push_back({.url = std::string(FILE_SCHEME) + path.string(),
+                                .security_level = entry.security_level,
+                                .source = entry.name_prefix + '/'
+                                          + std::filesystem::relative(path, entry.directory).string()});
+            if (entry.security_level > max_security) max_security = entry.security_level;
+        }
         for (const auto& src : entry.sources) {
-            requests.push_back({entry.url + "/" + src.name + entry.postfix + ".txt", src.security_level, ""});
+            requests.push_back({.url = entry.url + "/" + src.name + entry.postfix + entry.extension,
+                                .security_level = src.security_level,
+                                .source = entry.name_prefix + '/' + src.name});
             if (src.security_level > max_security) max_security = src.security_level;
         }
     }
@@ -90,6 +302,10 @@ void FortiHole::process_config() {
     lists_by_security_level = std::make_shared<std::vector<std::unordered_set<std::string>>>(total_size);
 
     locks = std::make_shared<std::vector<std::mutex>>(total_size);
+
+    allowlist = std::make_shared<const Allowlist>(config.allowlist);
+    if (config.allowlist.honor_source_exceptions) source_exceptions = std::make_shared<SourceExceptions>();
+
 }
 
 void FortiHole::fetch_multi() {
@@ -111,12 +327,22 @@ void FortiHole::fetch_multi() {
 
     for (auto& request : requests) {
         std::cout << "Fetching URL: " << request.url << std::endl;
+        if (request.url.starts_with(FILE_SCHEME)) {
+            load_local_file(request);
+            continue;
+        }
+        Tracer::Span span("download", "fetch", request.url);
+
+        Download download{request.response, Decompressor(Decompressor::from_path(request.url))};
 
         curl_easy_reset(easy_handle.get());
         curl_easy_setopt(easy_handle.get(), CURLOPT_URL, request.url.c_str());
         curl_easy_setopt(easy_handle.get(), CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(easy_handle.get(), CURLOPT_ACCEPT_ENCODING, "");  // every encoding libcurl was built with
+        curl_easy_setopt(easy_handle.get(), CURLOPT_HEADERFUNCTION, header_callback);
+        curl_easy_setopt(easy_handle.get(), CURLOPT_HEADERDATA, &download);
         curl_easy_setopt(easy_handle.get(), CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(easy_handle.get(), CURLOPT_WRITEDATA, &request.response);
+        curl_easy_setopt(easy_handle.get(), CURLOPT_WRITEDATA, &download);
 
         CURLMcode mc = curl_multi_add_handle(multi_handle.get(), easy_handle.get());
         if (mc != CURLM_OK) {
@@ -124,6 +350,8 @@ void FortiHole::fetch_multi() {
             continue;
         }
 
+        // a partial list is dropped like an unreadable local file, rather than pushed as if it were complete
+        bool complete = false;
         int still_running = 0;
         do {
             mc = curl_multi_perform(multi_handle.get(), &still_running);
@@ -141,6 +369,30 @@ void FortiHole::fetch_multi() {
             }
         } while (still_running);
 
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi_handle.get(), &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            complete = msg->data.result == CURLE_OK;
+            if (!complete)
+                std::cerr << "Failed to fetch " << request.url << ": "
+                          << (download.error.empty() ? curl_easy_strerror(msg->data.result) : download.error) << std::endl;
+        }
+
+        if (complete) {
+            try { download.decompressor.finish(); }
+            catch (const std::exception& e) {
+                std::cerr << request.url << ": " << e.what() << std::endl;
+                complete = false;
+            }
+        }
+        if (!complete) request.response.clear();
+
+        curl_off_t wire_bytes = 0;
+        curl_easy_getinfo(easy_handle.get(), CURLINFO_SIZE_DOWNLOAD_T, &wire_bytes);
+        span.set_payload(request.response.size());
+        std::cout << "Received " << wire_bytes / 1024 << " KiB, decoded " << request.response.size() / 1024
+                  << " KiB" << std::endl;
+
         curl_multi_remove_handle(multi_handle.get(), easy_handle.get());
     }
 
@@ -148,29 +400,39 @@ void FortiHole::fetch_multi() {
 }
 
 void FortiHole::process_multi() {
-    const size_t num_threads = std::thread::hardware_concurrency();
+    const size_t num_threads = threadPool.size();
+    const size_t page_size = MappedFile::page_size();
     futures.reserve(num_threads);
 
-    for (auto& request : requests) {
-        auto& content = request.response;
+    for (size_t index = 0; index < requests.size(); ++index) {
+        const auto& request = requests[index];
+        const auto& sketch = source_sketches.empty() ? nullptr : source_sketches[index];
+        const auto content = request.content();
         const size_t length = content.length();
-        const size_t chunk_size = length / num_threads;
 
-        for (size_t i = 0; i < num_threads; ++i) {
-            size_t start = i * chunk_size;
-            size_t end = (i + 1 == num_threads) ? length : (i + 1) * chunk_size;
+        // whole pages per task, so workers stream through disjoint parts of the page cache; small lists get
+        // fewer tasks instead of a handful of bytes each
+        const size_t chunk_size = std::max(page_size, (length / num_threads + page_size - 1) / page_size * page_size);
+
+        for (size_t start = 0, boundary = chunk_size; start < length; boundary += chunk_size) {
+            size_t end = std::clamp(boundary, start, length);
 
             // splits on spaces or newlines
-            if (end != length && end > 0)
-                while (end < length && content[end] != ' ' && content[end] != '\n') ++end;
+            while (end < length && content[end] != ' ' && content[end] != '\n') ++end;
+            if (end == start) continue;  // the previous chunk ran past this boundary
 
-            TaskWrapper task(std::make_unique<ResponseParser>(lists_by_security_level, request, start, end, locks));
+            TaskWrapper task(std::make_unique<ResponseParser>(lists_by_security_level, request, start, end, locks,
+                                                                allowlist, source_exceptions, sketch));
             futures.push_back(task.getFuture());
             threadPool.submit(task);
+            start = end;
         }
 
         // Ensure all futures are completed before continuing.
-        for (auto& future : futures) future.get();
+        {
+            Tracer::Span span("barrier", "pipeline", request.url, length);
+            for (auto& future : futures) future.get();
+        }
         futures.clear();
 
         std::cout << "Finished: " << request.url << std::endl;
@@ -178,7 +440,74 @@ void FortiHole::process_multi() {
     std::cout << "\nBlocklist processing successfully completed...\n" << std::endl;
 }
 
+void FortiHole::apply_source_exceptions() {
+    if (!source_exceptions || source_exceptions->domains.empty()) return;
+
+    Allowlist exceptions;
+    for (const auto& domain : source_exceptions->domains) exceptions.allow_suffix(domain);
+
+    // the lists lose the exception domains and their subdomains, the DNS responder also needs the rules themselves
+    // to let them through under a blocked parent
+    build.source_exceptions.assign(source_exceptions->domains.begin(), source_exceptions->domains.end());
+    std::sort(build.source_exceptions.begin(), build.source_exceptions.end());
+
+    size_t removed = 0;
+    for (auto& list : *lists_by_security_level)
+        removed += std::erase_if(list, [&exceptions](const auto& domain) { return exceptions.allows(domain); });
+
+    std::cout << "Applied " << source_exceptions->domains.size() << " '@@' exception rules from sources, unblocked "
+              << removed << " domains\n" << std::endl;
+}
+
+void FortiHole::report_sources() const {
+    if (source_sketches.empty()) return;
+
+    const auto& settings = config.source_report;
+    auto report = source_report(source_sketches, settings.min_jaccard, settings.max_overlaps);
+    const auto& sources = report["sources"];
+
+    std::cout << "Source report (estimates, ~1% error; exclusive = listed by no other source):\n"
+              << std::format("  {:>5} {:>10} {:>12} {:>10}  {}", "level", "domains", "contributed", "exclusive",
+                             "source") << std::endl;
+    for (const auto& source : sources) {
+        std::cout << std::format("  {:>5} {:>10} {:>12} {:>10}  {}", source["security_level"].get<unsigned int>(),
+                                 source["domains"].get<int64_t>(), source["contributed"].get<int64_t>(),
+                                 source["exclusive"].get<int64_t>(), source["source"].get<std::string>())
+                  << std::endl;
+    }
+
+    // a pair kept by both of its sources is reported once, from the lower index
+    std::vector<std::tuple<double, size_t, size_t>> overlaps;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        for (const auto& overlap : sources[i]["overlaps"]) {
+            auto j = overlap["index"].get<size_t>();
+            bool listed_by_other = std::ranges::any_of(sources[j]["overlaps"], [i](const auto& other) {
+                return other["index"].template get<size_t>() == i;
+            });
+            if (i < j || !listed_by_other) overlaps.emplace_back(overlap["jaccard"].get<double>(), i, j);
+        }
+    }
+    std::sort(overlaps.begin(), overlaps.end(), std::greater<>());
+
+    constexpr size_t MAX_PRINTED_OVERLAPS = 20;
+    if (!overlaps.empty()) std::cout << "Overlapping sources (Jaccard >= " << settings.min_jaccard << "):\n";
+    for (size_t i = 0; i < std::min(overlaps.size(), MAX_PRINTED_OVERLAPS); ++i) {
+        const auto& [jaccard, a, b] = overlaps[i];
+        std::cout << std::format("  {:.2f}  {} <-> {}", jaccard, sources[a]["source"].get<std::string>(),
+                                 sources[b]["source"].get<std::string>()) << std::endl;
+    }
+    if (overlaps.size() > MAX_PRINTED_OVERLAPS)
+        std::cout << "  ... " << overlaps.size() - MAX_PRINTED_OVERLAPS << " more" << std::endl;
+
+    if (!settings.file.empty()) {
+        write_source_report(settings.file, report, source_sketches);
+        std::cout << "Source report written to " << settings.file << std::endl;
+    }
+    std::cout << std::endl;
+}
+
 void FortiHole::build_threat_feed_info() {
+    auto& info_by_security_level = build.info_by_security_level;
     info_by_security_level.reserve(lists_by_security_level->size());
     unsigned int category = config.categories.base;
     total_num_files = 0;
@@ -191,53 +520,26 @@ void FortiHole::build_threat_feed_info() {
     }
 }
 
-void FortiHole::create_threat_feeds() {
-    for (unsigned int security_level = 0; security_level < info_by_security_level.size(); security_level++) {
-        auto info = info_by_security_level[security_level];
-        auto category = info.category_base;
-        for (unsigned int file_index = 0; file_index < info.file_count; ++file_index) {
-            auto filename = get_file_name(security_level, file_index + 1);
-            if (!ThreatFeed::contains(filename)) ThreatFeed::add(filename, category);
-            ++category;
-        }
-    }
-}
-
-void FortiHole::enable_filters_and_policies() {
-    for (const auto& dns_config : config.forti_hole_automated_dns_filters) {
-        if (!DNSFilter::contains(dns_config.dns_filter)) DNSFilter::add(dns_config.dns_filter);
-
-        auto dns_filter = DNSFilter::get(dns_config.dns_filter);
-        auto& firewall_policies = dns_config.firewall_policies;
-        auto& filters = dns_config.filters;
-
-        // enable dns filters for threat feed categories
-        for (const auto& filter : filters) {
-            auto security_level = filter.security_level;
-            auto info = info_by_security_level[security_level];
-            auto category = info.category_base;
-
-            for (unsigned int file_index = 0; file_index < info.file_count; ++file_index) {
-                if (filter.access == "block") dns_filter.block_category(category);
-                else if (filter.access == "allow") dns_filter.allow_category(category);
-                else if (filter.access == "monitor") dns_filter.monitor_category(category);
-                else throw std::runtime_error("Not a valid DNSFilter setting: " + filter.access);
-                ++category;
-            }
-        }
-
-        DNSFilter::update(dns_filter);
+void FortiHole::build_threat_feed_parts() {
+    auto& info_by_security_level = build.info_by_security_level;
+    futures.reserve(total_num_files);
 
-        // enable the dns filter in request firewall policies
-        for (const auto& policy_name : firewall_policies) {
-            auto policy = FortiGate::Policy::get(policy_name);
-            policy.dnsfilter_profile = dns_filter.name;
-            FortiGate::Policy::update(policy);
+    for (unsigned int security_level = 0; security_level < info_by_security_level.size(); ++security_level) {
+        auto& info = info_by_security_level[security_level];
+        auto starts = ThreatFeedBuilder::part_starts(lists_by_security_level->at(security_level), info);
+        for (unsigned int file_index = 0; file_index < info.file_count; ++file_index) {
+            auto filename = config.naming_convention.file_name(security_level, file_index + 1);
+            auto task = TaskWrapper(std::make_unique<ThreatFeedBuilder>(lists_by_security_level, filename, info,
+                                                                        security_level, file_index,
+                                                                        starts[file_index]));
+            futures.emplace_back(task.getFuture());
+            threadPool.submit(task);
         }
     }
-}
 
-void FortiHole::update_threat_feeds() {
+    // futures were submitted level by level, so they can be drained in the same order
+    build.parts_by_security_level.resize(info_by_security_level.size());
+    auto future = futures.begin();
     for (unsigned int security_level = 0; security_level < info_by_security_level.size(); ++security_level) {
         auto& info = info_by_security_level[security_level];
         std::cout << "Security Level " << security_level
@@ -246,40 +548,118 @@ void FortiHole::update_threat_feeds() {
                   << ", LPF: " << info.lines_per_file
                   << " }" << std::endl;
 
-        futures.reserve(info.file_count);
-        build_threat_feed_futures(security_level);
-        process_threat_feed_futures(security_level);
-        futures.clear();
+        auto& parts = build.parts_by_security_level[security_level];
+        parts.reserve(info.file_count);
+        for (unsigned int file_index = 0; file_index < info.file_count; ++file_index, ++future) {
+            auto res = future->get();
+
+            if (auto result = std::get_if<std::pair<std::string, std::vector<std::string>>>(&res)) {
+                auto& [filename, lines] = *result;
+                if (config.write_files_to_disk) create_file(filename, lines);
+                parts.push_back({std::move(filename), std::move(lines)});
+            } else std::cerr << "Error: Unexpected result type from future!" << std::endl;
+        }
     }
+
+    futures.clear();
+}
+
+void FortiHole::push_to_gateways() {
+    bool in_process = config.gateways.size() <= 1 || config.gateway_concurrency <= 1;
+    if (!(in_process ? push_to_gateways_in_process() : push_to_gateways_forked()))
+        throw std::runtime_error("Failed to update one or more gateways");
 }
 
-void FortiHole::build_threat_feed_futures(unsigned int security_level) {
-    auto& info = info_by_security_level[security_level];
+bool FortiHole::push_to_gateways_in_process() {
+    bool success = true;
+    for (const auto& gateway : config.gateways) {
+        try {
+            Gateway(gateway, config, build, gateway_journal_path(gateway))();
+            std::cout << '[' << gateway.name << "] Gateway updated successfully" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << '[' << gateway.name << "] Gateway update failed: " << e.what() << std::endl;
+            success = false;
+        }
+    }
+    return success;
+}
 
-    for (size_t file_index = 0; file_index < info.file_count; ++file_index) {
-        auto filename = get_file_name(security_level, file_index + 1);
-        auto task = TaskWrapper(std::make_unique<ThreatFeedBuilder>(lists_by_security_level,
-                                                                    filename, info, security_level, file_index));
-        futures.emplace_back(task.getFuture());
-        threadPool.submit(task);
+// forti-api holds its connection settings in process-global state, so concurrent gateways each get a forked
+// child sharing the computed build copy-on-write. Pool workers are idle by now, but in DNS mode the responder
+// thread keeps running through fork(). The child is still safe: it never touches the responder's state, and the
+// only locks the two share are malloc's and stdio's, which glibc re-initializes in the child.
+bool FortiHole::push_to_gateways_forked() {
+    auto exit_codes = run_forked(config.gateways.size(), config.gateway_concurrency, [this](size_t i) {
+        const auto& gateway = config.gateways[i];
+        Tracer::after_fork(gateway.name);
+        int code = EXIT_SUCCESS;
+        try { Gateway(gateway, config, build, gateway_journal_path(gateway))(); }
+        catch (const std::exception& e) {
+            std::cerr << '[' << gateway.name << "] " << e.what() << std::endl;
+            code = EXIT_FAILURE;
+        }
+        Tracer::flush();
+        return code;
+    });
+
+    bool success = true;
+    std::cout << "\nGateway summary:" << std::endl;
+    for (size_t i = 0; i < config.gateways.size(); ++i) {
+        bool ok = exit_codes[i] == EXIT_SUCCESS;
+        std::cout << "  " << config.gateways[i].name << ": "
+                  << (ok ? "updated" : "FAILED (exit " + std::to_string(exit_codes[i]) + ")") << std::endl;
+        success &= ok;
     }
+    return success;
 }
 
-void FortiHole::process_threat_feed_futures(unsigned int security_level) {
-    for (auto& future : futures) {
-        auto res = future.get();
+bool FortiHole::resume_from_journal() {
+    if (!config.journal.enabled) return false;
 
-        if (auto result = std::get_if<std::pair<std::string, std::vector<std::string>>>(&res)) {
+    const std::filesystem::path dir = config.journal.directory;
+    journal = Journal(dir / "journal.json");
+    if (!journal.resumable(config_hash, std::chrono::minutes(config.journal.max_resume_age_minutes))) return false;
 
-            const auto& [filename, to_upload] = *result;
-            if (config.write_files_to_disk) create_file(filename, to_upload);
-            ThreatFeed::update_feed({{filename, to_upload}});
+    auto cached = BuildCache::load(dir / "build");
+    if (!cached) return false;
 
-            std::cout << "Successfully pushed to Fortigate: " << filename << '\n' << std::endl;
-        } else std::cerr << "Error: Unexpected result type from future!" << std::endl;
-    }
+    build = std::move(*cached);
+    return true;
+}
+
+void FortiHole::start_journal() {
+    if (!config.journal.enabled) return;
+
+    const std::filesystem::path dir = config.journal.directory;
+    std::filesystem::create_directories(dir);
+    std::filesystem::remove_all(dir / "build");
+
+    auto started_at = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    journal = Journal(dir / "journal.json");
+    journal.reset({{"config_hash", config_hash}, {"started_at", started_at}});
+
+    for (const auto& gateway : config.gateways)
+        Journal(gateway_journal_path(gateway)).reset({{"gateway", gateway.name}});
+}
+
+void FortiHole::save_build_to_journal() {
+    if (!config.journal.enabled) return;
+    BuildCache::save(std::filesystem::path(config.journal.directory) / "build", build);
+    journal.complete_phase("built");
+}
 
-    remove_extra_files(security_level, info_by_security_level[security_level].file_count + 1);
+void FortiHole::finish_journal() {
+    if (!config.journal.enabled) return;
+    for (const auto& gateway : config.gateways) Journal(gateway_journal_path(gateway)).remove();
+    std::filesystem::remove_all(std::filesystem::path(config.journal.directory) / "build");
+    journal.remove();
+}
+
+std::filesystem::path FortiHole::gateway_journal_path(const GatewayConfig& gateway) const {
+    if (!config.journal.enabled) return {};
+
+    return std::filesystem::path(config.journal.directory) / ("gateway-" + file_safe_name(gateway.name) + ".json");
 }
 
 void FortiHole::create_file(const std::string& filename, const std::vector<std::string>& lines) const {
@@ -297,33 +677,3 @@ void FortiHole::create_file(const std::string& filename, const std::vector<std::
     outfile.close();
     std::cout << "Successfully wrote file: " << filename_w_extension << std::endl;
 }
-
-void FortiHole::remove_all_custom_threat_feeds() {
-    auto size = ThreatFeed::get().size();
-    for (const auto& connector : ThreatFeed::get()) {
-        auto name = connector.name;
-        std::cout << "\nDeleting: " << name << std::endl;
-        ThreatFeed::del(name);
-        std::cout << "Successfully deleted: " << name << std::endl;
-    }
-    std::cout << "Successfully removed " << size << " threat feeds..." << std::endl;
-    assert(ThreatFeed::get().empty());
-}
-
-void FortiHole::remove_extra_files(unsigned int security_level, unsigned int file_index) {
-    while (true) {
-        auto filename = get_file_name(security_level, file_index);
-        if (!ThreatFeed::contains(filename)) return;
-        ThreatFeed::del(filename);
-        ++file_index;
-    }
-}
-
-std::string FortiHole::get_file_name(unsigned int security_level, unsigned int file_index) {
-    return std::format("{}_{}-{}_{}-{}",
-                       config.naming_convention.prefix,
-                       config.naming_convention.security_level,
-                       security_level,
-                       config.naming_convention.file_index,
-                       file_index);
-}
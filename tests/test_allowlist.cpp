@@ -0,0 +1,65 @@
+#include "include/Task.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+AllowlistConfig test_config() {
+    AllowlistConfig config;
+    config.exact = {"login.example.com"};
+    config.suffix = {"cdn.example.net"};
+    config.patterns = {"*.sso.corp.io", "static-??.example.org", R"(/^img[0-9]+\.example\.com$/)"};
+    return config;
+}
+
+struct ParserFixture {
+    std::shared_ptr<std::vector<std::unordered_set<std::string>>> lists =
+            std::make_shared<std::vector<std::unordered_set<std::string>>>(1);
+    std::shared_ptr<std::vector<std::mutex>> locks = std::make_shared<std::vector<std::mutex>>(1);
+    std::shared_ptr<SourceExceptions> exceptions = std::make_shared<SourceExceptions>();
+
+    void parse(const std::string& content, const AllowlistConfig& config = {}) {
+        FortiHoleRequest request{"test", 0, content};
+        ResponseParser parser(lists, request, 0, static_cast<unsigned int>(content.size()), locks,
+                              std::make_shared<const Allowlist>(config), exceptions);
+        parser();
+    }
+};
+
+}
+
+TEST(TestAllowlist, MatchesExactSuffixAndPatterns) {
+    Allowlist allowlist(test_config());
+
+    EXPECT_TRUE(allowlist.allows("login.example.com"));
+    EXPECT_FALSE(allowlist.allows("a.login.example.com"));
+
+    EXPECT_TRUE(allowlist.allows("cdn.example.net"));
+    EXPECT_TRUE(allowlist.allows("eu.cdn.example.net"));
+    EXPECT_FALSE(allowlist.allows("xcdn.example.net"));
+
+    EXPECT_TRUE(allowlist.allows("idp.sso.corp.io"));
+    EXPECT_FALSE(allowlist.allows("sso.corp.io"));
+    EXPECT_TRUE(allowlist.allows("static-01.example.org"));
+    EXPECT_FALSE(allowlist.allows("static-001.example.org"));
+
+    EXPECT_TRUE(allowlist.allows("img42.example.com"));
+    EXPECT_FALSE(allowlist.allows("img.example.com"));
+
+    EXPECT_FALSE(allowlist.allows("ads.example.com"));
+    EXPECT_TRUE(Allowlist().empty());
+}
+
+TEST(TestAllowlist, ParserSkipsAllowlistedDomains) {
+    ParserFixture fixture;
+    fixture.parse("||ads.example.com^\n||eu.cdn.example.net^\n||login.example.com^\n", test_config());
+
+    EXPECT_EQ(fixture.lists->at(0), (std::unordered_set<std::string>{"ads.example.com"}));
+}
+
+TEST(TestAllowlist, ParserCollectsExceptionRules) {
+    ParserFixture fixture;
+    fixture.parse("||ads.example.com^\n@@||good.example.com^\n||tracker.example.com^\n");
+
+    EXPECT_EQ(fixture.lists->at(0), (std::unordered_set<std::string>{"ads.example.com", "tracker.example.com"}));
+    EXPECT_EQ(fixture.exceptions->domains, (std::unordered_set<std::string>{"good.example.com"}));
+}
@@ -0,0 +1,88 @@
+#include "include/Decompressor.h"
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <zstd.h>
+#include <stdexcept>
+
+namespace {
+
+const std::string LIST = "ads.example.com\ntracker.net\n";
+
+// LIST as compressed by brotli (quality 11), there is no encoder among the build dependencies
+const std::string BROTLI_LIST = {
+        '\x8b', '\x0d', '\x80', '\x61', '\x64', '\x73', '\x2e', '\x65', '\x78', '\x61', '\x6d', '\x70', '\x6c', '\x65',
+        '\x2e', '\x63', '\x6f', '\x6d', '\x0a', '\x74', '\x72', '\x61', '\x63', '\x6b', '\x65', '\x72', '\x2e', '\x6e',
+        '\x65', '\x74', '\x0a', '\x03'};
+
+std::string gzip(const std::string& data) {
+    z_stream stream{};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, data.size()) + 32, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+std::string zstd(const std::string& data) {
+    std::string out(ZSTD_compressBound(data.size()), '\0');
+    out.resize(ZSTD_compress(out.data(), out.size(), data.data(), data.size(), 3));
+    return out;
+}
+
+// feeds one byte at a time, the worst case for every streaming state machine
+std::string decode(Decompressor::Format format, const std::string& data, std::string_view content_encoding = "") {
+    Decompressor decompressor(format);
+    decompressor.declare_encoding(content_encoding);
+    std::string out;
+    for (char c : data) decompressor.feed(&c, 1, out);
+    decompressor.finish();
+    return out;
+}
+
+}
+
+TEST(TestDecompressor, DetectsFormatFromPath) {
+    EXPECT_EQ(Decompressor::from_path("https://example.com/hosts.gz"), Decompressor::Format::Gzip);
+    EXPECT_EQ(Decompressor::from_path("file:///srv/lists/hosts.zst"), Decompressor::Format::Zstd);
+    EXPECT_EQ(Decompressor::from_path("https://example.com/hosts.br?token=1"), Decompressor::Format::Brotli);
+    EXPECT_EQ(Decompressor::from_path("https://example.com/hosts.txt"), Decompressor::Format::None);
+}
+
+TEST(TestDecompressor, DecodesEveryFormatInTinyChunks) {
+    std::string large;
+    for (int i = 0; i < 20000; ++i) large += "host" + std::to_string(i) + ".example.com\n";
+
+    EXPECT_EQ(decode(Decompressor::Format::Gzip, gzip(large)), large);
+    EXPECT_EQ(decode(Decompressor::Format::Gzip, gzip(LIST) + gzip(LIST)), LIST + LIST);  // concatenated members
+    EXPECT_EQ(decode(Decompressor::Format::Zstd, zstd(large)), large);
+    EXPECT_EQ(decode(Decompressor::Format::Brotli, BROTLI_LIST), LIST);
+    EXPECT_EQ(decode(Decompressor::Format::None, LIST), LIST);
+}
+
+TEST(TestDecompressor, RejectsTruncatedAndCorruptStreams) {
+    for (auto [format, data] : {std::pair{Decompressor::Format::Gzip, gzip(LIST)},
+                                {Decompressor::Format::Zstd, zstd(LIST)},
+                                {Decompressor::Format::Brotli, BROTLI_LIST}}) {
+        EXPECT_THROW(decode(format, data.substr(0, data.size() - 4)), std::runtime_error);
+    }
+
+    auto corrupt = gzip(LIST);
+    corrupt[12] = static_cast<char>(~corrupt[12]);
+    EXPECT_THROW(decode(Decompressor::Format::Gzip, corrupt), std::runtime_error);
+    EXPECT_THROW(decode(Decompressor::Format::Brotli, LIST), std::runtime_error);
+}
+
+TEST(TestDecompressor, PassesThroughBodiesLibcurlAlreadyDecoded) {
+    EXPECT_EQ(decode(Decompressor::Format::Brotli, LIST, "br"), LIST);
+    EXPECT_EQ(decode(Decompressor::Format::Zstd, LIST, "identity, ZSTD"), LIST);
+    EXPECT_EQ(decode(Decompressor::Format::Gzip, LIST, "x-gzip"), LIST);
+
+    // other codings leave the file format to be decoded, a missing header falls back to the magic bytes
+    EXPECT_EQ(decode(Decompressor::Format::Brotli, BROTLI_LIST, "gzip"), LIST);
+    EXPECT_EQ(decode(Decompressor::Format::Gzip, LIST), LIST);
+}
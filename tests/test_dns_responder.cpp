@@ -0,0 +1,331 @@
+#include "include/DNSResponder.h"
+
+#ifdef __linux__
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cctype>
+#include <thread>
+
+namespace {
+
+std::vector<std::unordered_set<std::string>> test_lists() {
+    return {{"ads.example.com", "tracker.net"}, {"social.example.org"}};
+}
+
+std::vector<uint8_t> make_query(uint16_t id, const std::string& name, uint16_t qtype = 1) {
+    std::vector<uint8_t> query{static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id), 0x01, 0x00,
+                               0, 1, 0, 0, 0, 0, 0, 0};
+    size_t start = 0;
+    while (start <= name.size()) {
+        auto dot = std::min(name.find('.', start), name.size());
+        query.push_back(static_cast<uint8_t>(dot - start));
+        query.insert(query.end(), name.begin() + static_cast<long>(start), name.begin() + static_cast<long>(dot));
+        start = dot + 1;
+    }
+    query.push_back(0);
+    query.insert(query.end(), {static_cast<uint8_t>(qtype >> 8), static_cast<uint8_t>(qtype), 0, 1});
+    return query;
+}
+
+sockaddr_in loopback(uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+// What the fake upstream does to the echoed question before answering.
+enum class Echo { Exact, Uppercase, OtherName };
+
+constexpr size_t LARGE_ANSWER = 2000, OVERSIZED_DATAGRAM = 5000;
+
+// Answers every query NOERROR with the AA bit set so relayed answers are recognizable, over UDP and TCP on the
+// same port. 'large.*' answers carry LARGE_ANSWER bytes of records, which over UDP only fit with TC set (like a
+// resolver honoring the 512 byte limit); 'oversized.*' answers are OVERSIZED_DATAGRAM byte datagrams regardless.
+struct FakeUpstream {
+    int fd, tcp_fd;
+    uint16_t port{};
+    std::atomic<bool> running{true};
+    std::thread thread;
+
+    static std::vector<uint8_t> answer(const uint8_t* query, size_t length, Echo echo, bool tcp) {
+        std::vector<uint8_t> response(query, query + length);
+        response[2] |= 0x84;
+        if (echo == Echo::Uppercase)
+            for (size_t i = 13; i + 5 < length; ++i) response[i] = static_cast<uint8_t>(std::toupper(response[i]));
+        if (echo == Echo::OtherName) response[13] = response[13] == 'x' ? 'y' : 'x';
+
+        std::string_view first_label(reinterpret_cast<const char*>(query) + 13, query[12]);
+        if (first_label == "large" && tcp) response.resize(length + LARGE_ANSWER, 0xAB);
+        else if (first_label == "large") response[2] |= 0x02;
+        else if (first_label == "oversized") response.resize(OVERSIZED_DATAGRAM, 0xAB);
+        return response;
+    }
+
+    void serve_tcp(Echo echo) const {
+        int client = accept(tcp_fd, nullptr, nullptr);
+        if (client < 0) return;
+        timeval timeout{1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        uint8_t prefix[2], query[512];
+        while (recv(client, prefix, 2, MSG_WAITALL) == 2) {
+            size_t length = prefix[0] << 8 | prefix[1];
+            if (length < 12 || length > sizeof(query)) break;
+            if (recv(client, query, length, MSG_WAITALL) != static_cast<ssize_t>(length)) break;
+            auto response = answer(query, length, echo, true);
+            uint8_t framed[2] = {static_cast<uint8_t>(response.size() >> 8), static_cast<uint8_t>(response.size())};
+            send(client, framed, 2, MSG_NOSIGNAL);
+            send(client, response.data(), response.size(), MSG_NOSIGNAL);
+        }
+        close(client);
+    }
+
+    explicit FakeUpstream(Echo echo = Echo::Exact) : fd(socket(AF_INET, SOCK_DGRAM, 0)),
+                                                     tcp_fd(socket(AF_INET, SOCK_STREAM, 0)) {
+        auto address = loopback(0);
+        bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+        bind(tcp_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(tcp_fd, 16);
+
+        thread = std::thread([this, echo]() {
+            uint8_t buffer[512];
+            while (running) {
+                pollfd pfds[2] = {{fd, POLLIN, 0}, {tcp_fd, POLLIN, 0}};
+                if (poll(pfds, 2, 50) <= 0) continue;
+                if (pfds[1].revents & POLLIN) serve_tcp(echo);
+                if (!(pfds[0].revents & POLLIN)) continue;
+
+                sockaddr_in client{};
+                socklen_t client_length = sizeof(client);
+                auto n = recvfrom(fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&client), &client_length);
+                if (n < 12) continue;
+                auto response = answer(buffer, static_cast<size_t>(n), echo, false);
+                sendto(fd, response.data(), response.size(), 0, reinterpret_cast<sockaddr*>(&client), client_length);
+            }
+        });
+    }
+
+    ~FakeUpstream() {
+        running = false;
+        thread.join();
+        close(fd);
+        close(tcp_fd);
+    }
+};
+
+struct ResponderFixture {
+    FakeUpstream upstream;
+    std::unique_ptr<DNSResponder> responder;
+    std::thread thread;
+
+    explicit ResponderFixture(DNSServerConfig config, Echo echo = Echo::Exact,
+                              std::shared_ptr<const Allowlist> allowlist = nullptr) : upstream(echo) {
+        config.listen_address = "127.0.0.1";
+        config.port = 0;
+        config.upstream = "127.0.0.1";
+        config.upstream_port = upstream.port;
+        responder = std::make_unique<DNSResponder>(config, std::make_shared<DomainIndex>(test_lists()), allowlist);
+        thread = std::thread([this]() { responder->serve(); });
+    }
+
+    ~ResponderFixture() {
+        responder->stop();
+        thread.join();
+    }
+
+    std::vector<uint8_t> ask_udp(const std::vector<uint8_t>& query, time_t timeout_seconds = 2) const {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        timeval timeout{timeout_seconds, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        auto address = loopback(responder->port());
+        sendto(fd, query.data(), query.size(), 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+
+        std::vector<uint8_t> response(8192);
+        auto n = recv(fd, response.data(), response.size(), 0);
+        close(fd);
+        response.resize(n > 0 ? static_cast<size_t>(n) : 0);
+        return response;
+    }
+
+    std::vector<uint8_t> ask_tcp(const std::vector<uint8_t>& query) const {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout{2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        auto address = loopback(responder->port());
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return {};
+        }
+
+        std::vector<uint8_t> framed{static_cast<uint8_t>(query.size() >> 8), static_cast<uint8_t>(query.size())};
+        framed.insert(framed.end(), query.begin(), query.end());
+        send(fd, framed.data(), framed.size(), 0);
+
+        uint8_t prefix[2];
+        if (recv(fd, prefix, 2, MSG_WAITALL) != 2) {
+            close(fd);
+            return {};
+        }
+        std::vector<uint8_t> response(static_cast<size_t>(prefix[0] << 8 | prefix[1]));
+        auto n = recv(fd, response.data(), response.size(), MSG_WAITALL);
+        close(fd);
+        response.resize(n > 0 ? static_cast<size_t>(n) : 0);
+        return response;
+    }
+};
+
+uint8_t rcode(const std::vector<uint8_t>& response) { return response[3] & 0x0f; }
+uint16_t answer_count(const std::vector<uint8_t>& response) { return static_cast<uint16_t>(response[6] << 8 | response[7]); }
+bool relayed(const std::vector<uint8_t>& response) { return response[2] & 0x04; }
+bool truncated(const std::vector<uint8_t>& response) { return response[2] & 0x02; }
+
+}
+
+TEST(TestDNSResponder, DomainIndexMatchesParentDomains) {
+    DomainIndex index(test_lists());
+
+    EXPECT_EQ(index.size(), 3);
+    EXPECT_EQ(index.lookup("ads.example.com"), 0);
+    EXPECT_EQ(index.lookup("cdn.ads.example.com."), 0);
+    EXPECT_EQ(index.lookup("ADS.Example.COM"), 0);
+    EXPECT_EQ(index.lookup("social.example.org"), 1);
+    EXPECT_EQ(index.lookup("example.com"), DomainIndex::NOT_BLOCKED);
+    EXPECT_EQ(index.lookup("badads.example.com"), DomainIndex::NOT_BLOCKED);
+    EXPECT_EQ(index.lookup("tracker.network"), DomainIndex::NOT_BLOCKED);
+    EXPECT_TRUE(index.blocks("x.social.example.org", 1));
+    EXPECT_FALSE(index.blocks("x.social.example.org", 0));
+}
+
+TEST(TestDNSResponder, BlocksOverUdpAndTcp) {
+    ResponderFixture fixture(DNSServerConfig{});
+
+    auto response = fixture.ask_udp(make_query(0x1234, "img.ads.example.com"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(response[0], 0x12);
+    EXPECT_EQ(response[1], 0x34);
+    EXPECT_EQ(rcode(response), 3);
+    EXPECT_FALSE(relayed(response));
+
+    response = fixture.ask_tcp(make_query(0x4321, "tracker.net"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(rcode(response), 3);
+}
+
+TEST(TestDNSResponder, ForwardsUnblockedNamesAndRestoresId) {
+    ResponderFixture fixture(DNSServerConfig{});
+
+    auto response = fixture.ask_udp(make_query(0xBEEF, "example.com"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(response[0], 0xBE);
+    EXPECT_EQ(response[1], 0xEF);
+    EXPECT_TRUE(relayed(response));
+
+    response = fixture.ask_tcp(make_query(0xCAFE, "example.org"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(response[0], 0xCA);
+    EXPECT_TRUE(relayed(response));
+
+    auto stats = fixture.responder->stats();
+    EXPECT_EQ(stats.forwarded, 2);
+    EXPECT_EQ(stats.blocked, 0);
+}
+
+TEST(TestDNSResponder, AppliesClientSecurityLevels) {
+    DNSServerConfig config;
+    config.default_security_level = 1;
+    config.block_mode = "null";
+    ResponderFixture strict(config);
+
+    auto response = strict.ask_udp(make_query(1, "social.example.org"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(rcode(response), 0);
+    EXPECT_EQ(answer_count(response), 1);
+    EXPECT_EQ(response.size(), make_query(1, "social.example.org").size() + 16);
+
+    config.clients = {{"127.0.0.0/8", 0}};
+    ResponderFixture lenient(config);
+
+    response = lenient.ask_udp(make_query(2, "social.example.org"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_TRUE(relayed(response));
+}
+
+TEST(TestDNSResponder, DropsAnswersForAnotherQuestion) {
+    ResponderFixture matching(DNSServerConfig{}, Echo::Uppercase);
+    auto response = matching.ask_udp(make_query(7, "example.com"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_TRUE(relayed(response));
+
+    ResponderFixture forged(DNSServerConfig{}, Echo::OtherName);
+    EXPECT_TRUE(forged.ask_udp(make_query(8, "example.com"), 1).empty());
+    EXPECT_EQ(forged.responder->stats().forwarded, 1);
+}
+
+TEST(TestDNSResponder, LetsAllowlistedNamesThroughUnderBlockedParents) {
+    AllowlistConfig allowlist_config;
+    allowlist_config.exact = {"login.ads.example.com"};
+    auto allowlist = std::make_shared<Allowlist>(allowlist_config);
+    allowlist->allow_suffix("cdn.tracker.net");  // how '@@||cdn.tracker.net^' from a source arrives
+    ResponderFixture fixture(DNSServerConfig{}, Echo::Exact, allowlist);
+
+    EXPECT_TRUE(relayed(fixture.ask_udp(make_query(1, "login.ads.example.com"))));
+    EXPECT_TRUE(relayed(fixture.ask_tcp(make_query(2, "LOGIN.ads.example.com"))));
+    EXPECT_TRUE(relayed(fixture.ask_udp(make_query(3, "eu.cdn.tracker.net"))));
+
+    auto response = fixture.ask_udp(make_query(4, "x.login.ads.example.com"));  // exact rules cover one name only
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(rcode(response), 3);
+    response = fixture.ask_udp(make_query(5, "tracker.net"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(rcode(response), 3);
+
+    // a refresh replaces the allowlist along with the index
+    fixture.responder->set_index(std::make_shared<DomainIndex>(test_lists()));
+    response = fixture.ask_udp(make_query(6, "login.ads.example.com"));
+    ASSERT_GE(response.size(), 12);
+    EXPECT_EQ(rcode(response), 3);
+}
+
+TEST(TestDNSResponder, RelaysTcpQueriesOverTcp) {
+    ResponderFixture fixture(DNSServerConfig{});
+    auto query = make_query(0x0A0B, "large.example.com");
+
+    // too large for UDP, the client is told to retry over TCP
+    auto response = fixture.ask_udp(query);
+    ASSERT_GE(response.size(), 12);
+    EXPECT_TRUE(relayed(response));
+    EXPECT_TRUE(truncated(response));
+
+    // and over TCP the whole answer comes back
+    response = fixture.ask_tcp(query);
+    ASSERT_EQ(response.size(), query.size() + LARGE_ANSWER);
+    EXPECT_EQ(response[0], 0x0A);
+    EXPECT_TRUE(relayed(response));
+    EXPECT_FALSE(truncated(response));
+    EXPECT_EQ(response.back(), 0xAB);
+}
+
+TEST(TestDNSResponder, TurnsOversizedDatagramsIntoTruncatedAnswers) {
+    ResponderFixture fixture(DNSServerConfig{});
+    auto query = make_query(0x0C0D, "oversized.example.com");
+
+    // larger than the responder's datagram buffer, relaying what fit would hand out a corrupt answer
+    auto response = fixture.ask_udp(query);
+    ASSERT_EQ(response.size(), query.size());
+    EXPECT_EQ(response[0], 0x0C);
+    EXPECT_TRUE(relayed(response));
+    EXPECT_TRUE(truncated(response));
+    EXPECT_EQ(answer_count(response), 0);
+}
+
+#endif // __linux__
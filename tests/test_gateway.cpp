@@ -0,0 +1,98 @@
+#include "include/Gateway.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <csignal>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+std::vector<std::string> build_parts(const std::shared_ptr<std::vector<std::unordered_set<std::string>>>& lists,
+                                     const ThreatFeedInfo& info) {
+    auto starts = ThreatFeedBuilder::part_starts(lists->front(), info);
+    EXPECT_EQ(starts.size(), info.file_count);
+
+    std::vector<std::string> lines;
+    for (unsigned int part = 0; part < info.file_count; ++part) {
+        ThreatFeedBuilder builder(lists, "part-" + std::to_string(part), info, 0, part, starts[part]);
+        auto [filename, part_lines] = std::get<std::pair<std::string, std::vector<std::string>>>(builder());
+        EXPECT_EQ(part_lines.size(), builder.payload_size()) << filename;
+        lines.insert(lines.end(), part_lines.begin(), part_lines.end());
+    }
+    return lines;
+}
+
+}
+
+TEST(TestGateway, ThreatFeedPartsAreDisjointAndCoverTheList) {
+    for (unsigned int total : {0U, 1U, 7U, 1000U, 1001U}) {
+        for (unsigned int files : {1U, 3U, 8U}) {
+            auto lists = std::make_shared<std::vector<std::unordered_set<std::string>>>(1);
+            for (unsigned int i = 0; i < total; ++i) lists->front().insert("host" + std::to_string(i) + ".example.com");
+
+            auto lines = build_parts(lists, ThreatFeedInfo(total, files, 192));
+            std::unordered_set<std::string> seen(lines.begin(), lines.end());
+            EXPECT_EQ(lines.size(), total) << total << " lines in " << files << " files";
+            EXPECT_EQ(seen.size(), lines.size()) << "a line landed in two parts";
+            EXPECT_EQ(seen, lists->front());
+        }
+    }
+}
+
+TEST(TestGateway, RunForkedReportsExitCodes) {
+    auto codes = run_forked(4, 2, [](size_t i) {
+        if (i == 2) std::raise(SIGKILL);
+        if (i == 3) throw std::runtime_error("job failed");
+        return static_cast<int>(i);
+    });
+
+    ASSERT_EQ(codes.size(), 4U);
+    EXPECT_EQ(codes[0], 0);
+    EXPECT_EQ(codes[1], 1);
+    EXPECT_EQ(codes[2], 128 + SIGKILL);
+    EXPECT_EQ(codes[3], EXIT_FAILURE);
+    EXPECT_TRUE(run_forked(0, 4, [](size_t) { return 0; }).empty());
+}
+
+TEST(TestGateway, RunForkedRespectsConcurrency) {
+    struct Counters { std::atomic<int> running, peak; };
+    void* shared = mmap(nullptr, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(shared, MAP_FAILED);
+    auto* counters = new (shared) Counters{};
+
+    auto codes = run_forked(8, 3, [counters](size_t) {
+        int now = counters->running.fetch_add(1) + 1;
+        int peak = counters->peak.load();
+        while (now > peak && !counters->peak.compare_exchange_weak(peak, now)) {}
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        counters->running.fetch_sub(1);
+        return 0;
+    });
+
+    EXPECT_EQ(codes, std::vector<int>(8, 0));
+    EXPECT_GE(counters->peak.load(), 1);
+    EXPECT_LE(counters->peak.load(), 3);
+    munmap(shared, sizeof(Counters));
+}
+
+TEST(TestGateway, RunForkedLeavesOtherChildrenAlone) {
+    pid_t unrelated = fork();
+    ASSERT_GE(unrelated, 0);
+    if (unrelated == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        _exit(7);
+    }
+
+    auto codes = run_forked(2, 2, [](size_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return 0;
+    });
+    EXPECT_EQ(codes, std::vector<int>(2, 0));
+
+    int status = 0;
+    ASSERT_EQ(waitpid(unrelated, &status, 0), unrelated);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 7);
+}
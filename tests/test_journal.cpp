@@ -0,0 +1,144 @@
+#include "include/Journal.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct TempDir {
+    fs::path path;
+
+    TempDir() {
+        std::string pattern = (fs::temp_directory_path() / "forti-hole-journal-XXXXXX").string();
+        if (!mkdtemp(pattern.data())) throw std::runtime_error("mkdtemp() failed");
+        path = pattern;
+    }
+
+    ~TempDir() { fs::remove_all(path); }
+};
+
+std::string read(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), {}};
+}
+
+ThreatFeedBuild sample_build() {
+    ThreatFeedBuild build;
+    build.info_by_security_level = {ThreatFeedInfo(3, 2, 192), ThreatFeedInfo(1, 1, 194)};
+    build.parts_by_security_level = {{{"level-0-part-1", {"ads.example.com", "tracker.net"}},
+                                      {"level-0-part-2", {"malware.org"}}},
+                                     {{"level-1-part-1", {"social.example.com"}}}};
+    build.source_exceptions = {"login.example.com"};
+    return build;
+}
+
+Journal started_journal(const fs::path& path, uint64_t config_hash, std::chrono::system_clock::time_point started) {
+    Journal journal(path);
+    journal.reset({{"config_hash", config_hash},
+                   {"started_at", std::chrono::duration_cast<std::chrono::seconds>(started.time_since_epoch()).count()}});
+    journal.complete_phase("built");
+    return journal;
+}
+
+}
+
+TEST(TestJournal, WritesFilesAtomically) {
+    TempDir dir;
+    write_file_atomically(dir.path / "state.json", "first");
+    write_file_atomically(dir.path / "state.json", "second");
+
+    EXPECT_EQ(read(dir.path / "state.json"), "second");
+    EXPECT_FALSE(fs::exists(dir.path / "state.json.tmp"));
+    EXPECT_THROW(write_file_atomically(dir.path / "missing" / "state.json", "data"), std::runtime_error);
+}
+
+TEST(TestJournal, RoundTripsThroughTheJournalFile) {
+    TempDir dir;
+    const auto path = dir.path / "journal.json";
+    {
+        Journal journal(path);
+        EXPECT_FALSE(journal.exists());
+        journal.reset({{"gateway", "fw-1"}});
+        journal.complete_phase("feeds_created");
+        journal.record_part("level-0-part-1", 42);
+    }
+
+    Journal reloaded(path);
+    ASSERT_TRUE(reloaded.exists());
+    EXPECT_EQ(reloaded.header()["gateway"], "fw-1");
+    EXPECT_TRUE(reloaded.has_phase("feeds_created"));
+    EXPECT_FALSE(reloaded.has_phase("complete"));
+    EXPECT_TRUE(reloaded.has_part("level-0-part-1", 42));
+    EXPECT_FALSE(reloaded.has_part("level-0-part-1", 43));  // same file, different content
+
+    reloaded.remove();
+    EXPECT_FALSE(fs::exists(path));
+    EXPECT_FALSE(Journal(path).exists());
+
+    std::ofstream(path) << "{\"header\": ";  // torn by a crash mid-write
+    EXPECT_FALSE(Journal(path).exists());
+}
+
+TEST(TestJournal, BuildCacheRoundTripsAndRejectsTamperedParts) {
+    TempDir dir;
+    const auto cache = dir.path / "build";
+    EXPECT_FALSE(BuildCache::load(cache));
+
+    auto build = sample_build();
+    BuildCache::save(cache, build);
+
+    auto loaded = BuildCache::load(cache);
+    ASSERT_TRUE(loaded);
+    ASSERT_EQ(loaded->info_by_security_level.size(), 2U);
+    EXPECT_EQ(loaded->info_by_security_level[0].file_count, 2U);
+    EXPECT_EQ(loaded->info_by_security_level[1].category_base, 194U);
+    ASSERT_EQ(loaded->parts_by_security_level.size(), 2U);
+    EXPECT_EQ(loaded->parts_by_security_level[0][0].lines, build.parts_by_security_level[0][0].lines);
+    EXPECT_EQ(loaded->parts_by_security_level[1][0].filename, "level-1-part-1");
+    EXPECT_EQ(loaded->source_exceptions, build.source_exceptions);
+
+    std::ofstream(cache / "parts" / "level-0-part-2.txt", std::ios::app) << "injected.example.com\n";
+    EXPECT_FALSE(BuildCache::load(cache));
+}
+
+TEST(TestJournal, ResumesOnlyUnfinishedRunsOfTheSameConfig) {
+    TempDir dir;
+    const auto path = dir.path / "journal.json";
+    const auto now = std::chrono::system_clock::now();
+    const auto max_age = std::chrono::minutes(180);
+
+    auto journal = started_journal(path, 1234, now - std::chrono::minutes(5));
+    EXPECT_TRUE(Journal(path).resumable(1234, max_age, now));
+    EXPECT_FALSE(Journal(path).resumable(5678, max_age, now));  // config changed
+    EXPECT_FALSE(Journal(path).resumable(1234, max_age, now + std::chrono::hours(3)));  // too old
+
+    journal.complete_phase("complete");
+    EXPECT_FALSE(Journal(path).resumable(1234, max_age, now));
+
+    journal.reset({{"config_hash", 1234}});  // crashed before the build finished
+    EXPECT_FALSE(Journal(path).resumable(1234, max_age, now));
+    EXPECT_FALSE(Journal(dir.path / "missing.json").resumable(1234, max_age, now));
+}
+
+TEST(TestJournal, ResumedPushSkipsJournaledParts) {
+    TempDir dir;
+    const auto path = dir.path / "gateway.json";
+    auto build = sample_build();
+    const auto& parts = build.parts_by_security_level[0];
+    {
+        Journal journal(path);
+        journal.reset();
+        ASSERT_EQ(journal.unpushed_parts(parts).size(), 2U);
+        journal.record_part(parts[0].filename, Journal::part_hash(parts[0].lines));
+    }
+
+    auto unpushed = Journal(path).unpushed_parts(parts);
+    ASSERT_EQ(unpushed.size(), 1U);
+    EXPECT_EQ(unpushed[0], &parts[1]);
+
+    // a part whose content changed since it was journaled is pushed again
+    build.parts_by_security_level[0][0].lines.emplace_back("new.example.com");
+    EXPECT_EQ(Journal(path).unpushed_parts(parts).size(), 2U);
+}
@@ -0,0 +1,67 @@
+#include "include/Task.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+// a fresh file per call, so parallel or repeated test runs never share one
+std::filesystem::path write_temp_file(const std::string& content) {
+    std::string pattern = (std::filesystem::temp_directory_path() / "forti-hole-mapped-XXXXXX").string();
+    int fd = mkstemp(pattern.data());
+    if (fd < 0) throw std::runtime_error("mkstemp() failed");
+
+    for (size_t written = 0; written < content.size();) {
+        auto n = ::write(fd, content.data() + written, content.size() - written);
+        if (n <= 0) {
+            ::close(fd);
+            throw std::runtime_error("write() failed");
+        }
+        written += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    return pattern;
+}
+
+}
+
+TEST(TestMappedFile, MapsContentAndEmptyFiles) {
+    auto path = write_temp_file("||ads.example.com^\n");
+    MappedFile mapped(path);
+    EXPECT_EQ(mapped.view(), "||ads.example.com^\n");
+
+    MappedFile moved(std::move(mapped));
+    EXPECT_EQ(moved.size(), 19U);
+    EXPECT_TRUE(mapped.view().empty());
+
+    auto empty = write_temp_file("");
+    EXPECT_TRUE(MappedFile(empty).view().empty());
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(empty);
+    EXPECT_THROW(MappedFile{path}, std::runtime_error);
+}
+
+TEST(TestMappedFile, ParsesMappedRequestInPlace) {
+    auto path = write_temp_file("! comment\n||ads.example.com^\n@@||ok.example.com^\n||tracker.example.net^\n");
+
+    FortiHoleRequest request{"file://" + path.string(), 0, ""};
+    request.mapping = std::make_shared<const MappedFile>(path);
+    auto content = request.content();
+    EXPECT_EQ(content.data(), request.mapping->view().data());
+
+    auto lists = std::make_shared<std::vector<std::unordered_set<std::string>>>(1);
+    auto locks = std::make_shared<std::vector<std::mutex>>(1);
+    auto exceptions = std::make_shared<SourceExceptions>();
+
+    // split mid-file on a newline, the way process_multi chunks
+    auto split = content.find("@@");
+    for (auto [start, end] : {std::pair<size_t, size_t>{0, split}, {split, content.size()}})
+        ResponseParser(lists, request, start, end, locks, std::make_shared<const Allowlist>(), exceptions)();
+
+    EXPECT_EQ(lists->at(0), (std::unordered_set<std::string>{"ads.example.com", "tracker.example.net"}));
+    EXPECT_EQ(exceptions->domains, (std::unordered_set<std::string>{"ok.example.com"}));
+
+    std::filesystem::remove(path);
+}
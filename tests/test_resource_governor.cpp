@@ -0,0 +1,104 @@
+#include "include/ResourceGovernor.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A throwaway /sys/fs/cgroup lookalike plus the /proc/self/cgroup that points into it.
+struct FakeCgroup {
+    fs::path root;
+
+    FakeCgroup() {
+        std::string pattern = (fs::temp_directory_path() / "forti-hole-cgroup-XXXXXX").string();
+        if (!mkdtemp(pattern.data())) throw std::runtime_error("mkdtemp() failed");
+        root = pattern;
+    }
+
+    ~FakeCgroup() { fs::remove_all(root); }
+
+    void write(const fs::path& relative, const std::string& content) const {
+        fs::create_directories((root / relative).parent_path());
+        std::ofstream(root / relative) << content << '\n';
+    }
+
+    [[nodiscard]] fs::path self() const { return root / "self-cgroup"; }
+};
+
+}
+
+TEST(TestResourceGovernor, ParsesCpuLists) {
+    using ResourceGovernor::parse_cpu_list;
+    EXPECT_EQ(parse_cpu_list("0,2-4,7"), (std::vector<unsigned int>{0, 2, 3, 4, 7}));
+    EXPECT_EQ(parse_cpu_list("3"), (std::vector<unsigned int>{3}));
+    EXPECT_EQ(parse_cpu_list("1,,2"), (std::vector<unsigned int>{1, 2}));
+    EXPECT_TRUE(parse_cpu_list("").empty());
+
+    EXPECT_THROW(parse_cpu_list("4-2"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("-1"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("1--2"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("0-4000000000"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("a"), std::invalid_argument);
+}
+
+TEST(TestResourceGovernor, RejectsNegativeCounts) {
+    EXPECT_EQ(ResourceGovernor::parse_unsigned("8"), 8);
+    EXPECT_THROW(ResourceGovernor::parse_unsigned("-1"), std::invalid_argument);
+    EXPECT_THROW(ResourceGovernor::parse_unsigned("+1"), std::invalid_argument);
+    EXPECT_THROW(ResourceGovernor::parse_unsigned(""), std::invalid_argument);
+    EXPECT_THROW(ResourceGovernor::parse_unsigned("99999999999"), std::out_of_range);
+}
+
+TEST(TestResourceGovernor, ReadsCgroupV2LimitsUpTheHierarchy) {
+    FakeCgroup cgroup;
+    cgroup.write(cgroup.self(), "0::/system.slice/forti-hole.service");
+    cgroup.write("system.slice/forti-hole.service/cpu.max", "max 100000");
+    cgroup.write("system.slice/forti-hole.service/memory.max", "max");
+    cgroup.write("system.slice/cpu.max", "150000 100000");  // the tighter ancestor wins
+    cgroup.write("system.slice/memory.max", "536870912");
+    cgroup.write("cpu.max", "400000 100000");
+
+    EXPECT_DOUBLE_EQ(ResourceGovernor::cgroup_cpu_limit(cgroup.root, cgroup.self()).value_or(0), 1.5);
+    EXPECT_EQ(ResourceGovernor::cgroup_memory_limit(cgroup.root, cgroup.self()).value_or(0), 536870912U);
+}
+
+TEST(TestResourceGovernor, ReadsCgroupV1Limits) {
+    FakeCgroup cgroup;
+    cgroup.write(cgroup.self(), "4:memory:/docker/abc\n3:cpu,cpuacct:/docker/abc\n1:name=systemd:/docker/abc");
+    cgroup.write("cpu,cpuacct/docker/abc/cpu.cfs_quota_us", "200000");
+    cgroup.write("cpu,cpuacct/docker/abc/cpu.cfs_period_us", "100000");
+    cgroup.write("memory/docker/abc/memory.limit_in_bytes", "1073741824");
+    cgroup.write("memory/memory.limit_in_bytes", "9223372036854771712");  // v1 for unlimited
+
+    EXPECT_DOUBLE_EQ(ResourceGovernor::cgroup_cpu_limit(cgroup.root, cgroup.self()).value_or(0), 2.0);
+    EXPECT_EQ(ResourceGovernor::cgroup_memory_limit(cgroup.root, cgroup.self()).value_or(0), 1073741824U);
+}
+
+TEST(TestResourceGovernor, NoLimitsWithoutCgroupFiles) {
+    FakeCgroup cgroup;
+    cgroup.write(cgroup.self(), "0::/");
+    cgroup.write("cpu.max", "max 100000");
+
+    EXPECT_FALSE(ResourceGovernor::cgroup_cpu_limit(cgroup.root, cgroup.self()));
+    EXPECT_FALSE(ResourceGovernor::cgroup_memory_limit(cgroup.root, cgroup.self()));
+    EXPECT_FALSE(ResourceGovernor::cgroup_cpu_limit(cgroup.root, cgroup.root / "missing"));
+}
+
+TEST(TestResourceGovernor, MalformedCgroupFilesMeanNoLimit) {
+    FakeCgroup v2;
+    v2.write(v2.self(), "0::/");
+    v2.write("cpu.max", "lots 100000");
+    v2.write("memory.max", "12GB");
+    EXPECT_FALSE(ResourceGovernor::cgroup_cpu_limit(v2.root, v2.self()));
+    EXPECT_FALSE(ResourceGovernor::cgroup_memory_limit(v2.root, v2.self()));
+
+    FakeCgroup v1;
+    v1.write(v1.self(), "4:memory:/\n3:cpu,cpuacct:/");
+    v1.write("cpu,cpuacct/cpu.cfs_quota_us", "");
+    v1.write("cpu,cpuacct/cpu.cfs_period_us", "100000");
+    v1.write("memory/memory.limit_in_bytes", "-1");
+    EXPECT_FALSE(ResourceGovernor::cgroup_cpu_limit(v1.root, v1.self()));
+    EXPECT_FALSE(ResourceGovernor::cgroup_memory_limit(v1.root, v1.self()));
+}
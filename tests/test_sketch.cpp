@@ -0,0 +1,108 @@
+#include "include/Sketch.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+
+std::string domain(size_t i) { return "host" + std::to_string(i) + ".example.com"; }
+
+std::shared_ptr<SourceSketch> sketch_range(const std::string& name, size_t begin, size_t end,
+                                           unsigned int security_level = 0) {
+    auto source = std::make_shared<SourceSketch>(name, security_level);
+    for (size_t i = begin; i < end; ++i) source->sketch.add(sketch_hash(domain(i)));
+    return source;
+}
+
+}
+
+TEST(TestSketch, HyperLogLogEstimatesAndMerges) {
+    HyperLogLog small, a, b;
+    for (size_t i = 0; i < 1000; ++i) small.add(sketch_hash(domain(i)));
+    EXPECT_NEAR(small.estimate(), 1000, 20);
+
+    for (size_t i = 0; i < 200000; ++i) {
+        a.add(sketch_hash(domain(i)));
+        a.add(sketch_hash(domain(i)));  // duplicates never count twice
+    }
+    for (size_t i = 100000; i < 300000; ++i) b.add(sketch_hash(domain(i)));
+    EXPECT_NEAR(a.estimate(), 200000, 200000 * 0.03);
+
+    a.merge(b);
+    EXPECT_NEAR(a.estimate(), 300000, 300000 * 0.03);
+    EXPECT_EQ(HyperLogLog().estimate(), 0);
+}
+
+TEST(TestSketch, MinHashEstimatesJaccard) {
+    MinHash a, b, disjoint;
+    for (size_t i = 0; i < 30000; ++i) a.add(sketch_hash(domain(i)));
+    for (size_t i = 10000; i < 40000; ++i) b.add(sketch_hash(domain(i)));
+    for (size_t i = 50000; i < 60000; ++i) disjoint.add(sketch_hash(domain(i)));
+
+    EXPECT_NEAR(a.jaccard(b), 0.5, 0.1);  // 20000 shared of 40000
+    EXPECT_DOUBLE_EQ(a.jaccard(a), 1.0);
+    EXPECT_LT(a.jaccard(disjoint), 0.02);
+}
+
+TEST(TestSketch, ReportsExclusiveContribution) {
+    // 'mirror' is a strict subset of 'full', so it adds nothing no other source has
+    auto report = source_report({sketch_range("full", 0, 50000), sketch_range("mirror", 0, 25000),
+                                 sketch_range("extra", 45000, 60000)}, 0.25);
+
+    EXPECT_NEAR(report["total_domains"].get<double>(), 60000, 60000 * 0.03);
+
+    const auto& sources = report["sources"];
+    ASSERT_EQ(sources.size(), 3U);
+    EXPECT_NEAR(sources[0]["exclusive"].get<double>(), 20000, 2000);
+    EXPECT_LT(sources[1]["exclusive"].get<double>(), 1500);
+    EXPECT_NEAR(sources[2]["exclusive"].get<double>(), 10000, 2000);
+    ASSERT_EQ(sources[1]["overlaps"].size(), 1U);  // 'extra' shares nothing with 'mirror'
+    EXPECT_EQ(sources[1]["overlaps"][0]["index"], 0);
+    EXPECT_NEAR(sources[1]["overlaps"][0]["jaccard"].get<double>(), 0.5, 0.1);
+}
+
+TEST(TestSketch, ContributedCountsOnlyDomainsMissingFromLowerLevels) {
+    // listed in submission order, not by level, the report must not depend on either
+    auto report = source_report({sketch_range("strict", 30000, 60000, 1), sketch_range("base", 0, 40000, 0),
+                                 sketch_range("base-mirror", 0, 20000, 0), sketch_range("paranoid", 0, 70000, 2)},
+                                1.0);
+
+    const auto& sources = report["sources"];
+    ASSERT_EQ(sources.size(), 4U);
+    EXPECT_NEAR(sources[0]["contributed"].get<double>(), 20000, 2000);  // 40000-59999
+    EXPECT_NEAR(sources[1]["contributed"].get<double>(), sources[1]["domains"].get<double>(), 1);  // nothing below
+    EXPECT_NEAR(sources[2]["contributed"].get<double>(), 20000, 20000 * 0.03);  // same level does not count
+    EXPECT_NEAR(sources[3]["contributed"].get<double>(), 10000, 2000);  // 60000-69999
+}
+
+TEST(TestSketch, KeepsOnlyTheClosestOverlapsKeyedByIndex) {
+    // two directories with a file of the same name must not overwrite each other's overlaps
+    std::vector<std::shared_ptr<SourceSketch>> sketches{
+            sketch_range("hosts.txt", 0, 10000), sketch_range("hosts.txt", 0, 9000), sketch_range("near", 0, 8000),
+            sketch_range("far", 0, 2000), sketch_range("unrelated", 50000, 60000)};
+    auto report = source_report(sketches, 0.5, 2);
+
+    const auto& overlaps = report["sources"][0]["overlaps"];
+    ASSERT_EQ(overlaps.size(), 2U);  // 'far' is below the threshold, 'unrelated' shares nothing
+    EXPECT_EQ(overlaps[0]["index"], 1);
+    EXPECT_EQ(overlaps[0]["source"], "hosts.txt");
+    EXPECT_EQ(overlaps[1]["index"], 2);
+    EXPECT_GT(overlaps[0]["jaccard"].get<double>(), overlaps[1]["jaccard"].get<double>());
+    EXPECT_EQ(report["sources"][1]["overlaps"][0]["index"], 0);
+    EXPECT_TRUE(report["sources"][4]["overlaps"].empty());
+
+    std::string pattern = (std::filesystem::temp_directory_path() / "forti-hole-sketch-XXXXXX").string();
+    ASSERT_TRUE(mkdtemp(pattern.data()));
+    const std::filesystem::path dir = pattern;
+    write_source_report(dir / "report.json", report, sketches);
+    auto written = nlohmann::json::parse(std::ifstream(dir / "report.json"));
+    std::filesystem::remove_all(dir);
+
+    EXPECT_EQ(written["total_domains"], report["total_domains"]);
+    ASSERT_EQ(written["sources"].size(), sketches.size());
+    const auto& far = written["sources"][3];
+    EXPECT_EQ(far["overlaps"], report["sources"][3]["overlaps"]);
+    ASSERT_EQ(far["jaccard"].size(), sketches.size());  // the full matrix keeps pairs below the threshold
+    EXPECT_NEAR(far["jaccard"][0].get<double>(), 0.2, 0.1);
+    EXPECT_EQ(far["jaccard"][3], 1.0);
+}
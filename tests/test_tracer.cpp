@@ -0,0 +1,105 @@
+#include "include/Tracer.h"
+#include "include/hash.h"
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// The tracer is process wide, so every test traces into a directory of its own.
+struct TraceDir {
+    fs::path path;
+
+    TraceDir() {
+        std::string pattern = (fs::temp_directory_path() / "forti-hole-trace-XXXXXX").string();
+        if (!mkdtemp(pattern.data())) throw std::runtime_error("mkdtemp() failed");
+        path = pattern;
+        Tracer::enable(path / "trace.json");
+    }
+
+    ~TraceDir() { fs::remove_all(path); }
+
+    [[nodiscard]] nlohmann::json read(const std::string& filename = "trace.json") const {
+        std::ifstream in(path / filename);
+        return nlohmann::json::parse(in);  // throws on anything that is not valid JSON
+    }
+};
+
+// complete ('X') events by detail, and the names of the process and threads
+struct Timeline {
+    std::map<std::string, nlohmann::json> events;
+    std::string process;
+    std::map<int64_t, std::string> threads;
+
+    explicit Timeline(const nlohmann::json& trace) {
+        for (const auto& event : trace.at("traceEvents")) {
+            if (event["name"] == "process_name") process = event["args"]["name"];
+            else if (event["name"] == "thread_name") threads[event["tid"]] = event["args"]["name"];
+            else if (event["ph"] == "X" && event["args"].contains("detail")) events[event["args"]["detail"]] = event;
+        }
+    }
+};
+
+}
+
+TEST(TestTracer, FlushesEventsOfExitedThreadsOnce) {
+    TraceDir dir;
+
+    std::thread([]() {
+        Tracer::set_thread_name("short-lived \"worker\"");
+        Tracer::Span span("task", "pool", "exited-thread", 42);
+    }).join();
+    { Tracer::Span span("phase", "pipeline", "main-thread"); }
+
+    Tracer::flush();
+    Timeline first(dir.read());
+    ASSERT_TRUE(first.events.contains("exited-thread"));
+    ASSERT_TRUE(first.events.contains("main-thread"));
+    const auto& retired = first.events["exited-thread"];
+    EXPECT_EQ(retired["args"]["payload"], 42);
+    EXPECT_EQ(first.threads[retired["tid"]], "short-lived \"worker\"");
+    EXPECT_GE(retired["dur"].get<double>(), 0);
+    EXPECT_EQ(first.process, "forti-hole");
+
+    // the exited thread's buffer went with that flush, live threads keep theirs
+    Tracer::flush();
+    Timeline second(dir.read());
+    EXPECT_FALSE(second.events.contains("exited-thread"));
+    EXPECT_FALSE(second.threads.contains(retired["tid"]));
+    EXPECT_TRUE(second.events.contains("main-thread"));
+}
+
+TEST(TestTracer, ForkedChildWritesItsOwnNamedTrace) {
+    TraceDir dir;
+    { Tracer::Span span("phase", "pipeline", "before-fork"); }
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        Tracer::after_fork("fw/1");
+        { Tracer::Span span("gateway", "gateway", "in-child"); }
+        Tracer::flush();
+        _exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    Timeline child(dir.read("trace." + file_safe_name("fw/1") + ".json"));
+    EXPECT_EQ(child.process, "forti-hole fw/1");
+    EXPECT_TRUE(child.events.contains("in-child"));
+    EXPECT_FALSE(child.events.contains("before-fork"));  // the parent's events stay with the parent
+
+    Tracer::flush();
+    Timeline parent(dir.read());
+    EXPECT_EQ(parent.process, "forti-hole");
+    EXPECT_TRUE(parent.events.contains("before-fork"));
+    EXPECT_FALSE(parent.events.contains("in-child"));
+}